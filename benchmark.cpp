@@ -0,0 +1,203 @@
+/*
+ * Compiler Output Parser: Parse error, warning and messages
+ * Copyright (C) 2024  Christo Joseph
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "compiler_output_parser.hpp"
+#include "log_file.hpp"
+#include "log_generator.hpp"
+
+namespace
+{
+struct Corpus
+{
+    std::string_view data;
+    size_t lineCount{0};
+};
+
+// Lines of the corpus grouped by the rule that matches them, CompilerOutputRule::none being the lines nothing matches
+std::map<CompilerOutputRule, std::string> SplitByRule(std::string_view data)
+{
+    std::map<CompilerOutputRule, std::string> lines;
+    ForEachCompilerOutputLine(data,
+                              [&lines](std::string_view line)
+                              {
+                                  std::string& group = lines[GetCompilerOutputLineView(line).rule];
+                                  group += line;
+                                  group += '\n';
+                              });
+    return lines;
+}
+
+size_t CountLines(std::string_view data)
+{
+    size_t count = 0;
+    ForEachCompilerOutputLine(data, [&count](std::string_view) { ++count; });
+    return count;
+}
+
+void SetThroughput(benchmark::State& state, const Corpus& corpus)
+{
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * corpus.lineCount));
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * corpus.data.size()));
+    state.counters["lines"] = static_cast<double>(corpus.lineCount);
+}
+
+void ParseLineViews(benchmark::State& state, Corpus corpus)
+{
+    for (auto _ : state)
+    {
+        ForEachCompilerOutputLine(corpus.data, [](std::string_view line) { benchmark::DoNotOptimize(GetCompilerOutputLineView(line)); });
+    }
+    SetThroughput(state, corpus);
+}
+
+void ParseLineInfos(benchmark::State& state, Corpus corpus)
+{
+    for (auto _ : state)
+    {
+        ForEachCompilerOutputLine(corpus.data, [](std::string_view line) { benchmark::DoNotOptimize(GetCompilerOutputLineInfo(line)); });
+    }
+    SetThroughput(state, corpus);
+}
+
+// The results of a whole log kept and then released, from the global heap
+void KeepLineInfos(benchmark::State& state, Corpus corpus)
+{
+    for (auto _ : state)
+    {
+        std::vector<CompilerOutputLineInfo> infos;
+        ForEachCompilerOutputLine(corpus.data, [&infos](std::string_view line) { infos.push_back(GetCompilerOutputLineInfo(line)); });
+        benchmark::DoNotOptimize(infos.data());
+    }
+    SetThroughput(state, corpus);
+}
+
+// The same from an arena per log, released at once with it
+void KeepPmrLineInfos(benchmark::State& state, Corpus corpus)
+{
+    for (auto _ : state)
+    {
+        std::pmr::monotonic_buffer_resource arena(corpus.data.size());
+        std::pmr::vector<CompilerOutputPmrLineInfo> infos(&arena);
+        ForEachCompilerOutputLine(corpus.data, [&](std::string_view line) { infos.push_back(GetCompilerOutputLineInfo(line, &arena)); });
+        benchmark::DoNotOptimize(infos.data());
+    }
+    SetThroughput(state, corpus);
+}
+
+void ParseBatch(benchmark::State& state, Corpus corpus)
+{
+    for (auto _ : state)
+    {
+        CompilerOutputBatch batch = ParseCompilerOutput(corpus.data);
+        benchmark::DoNotOptimize(batch.types.data());
+    }
+    SetThroughput(state, corpus);
+}
+
+void PrintUsage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [--corpus=FILE] [--corpus-size=MB] [--write-corpus=FILE] [benchmark options]\n"
+            "  --corpus=FILE        benchmark a real log instead of the synthetic one\n"
+            "  --corpus-size=MB     size of the synthetic log, 32 by default\n"
+            "  --write-corpus=FILE  write the synthetic log to FILE and exit\n",
+            program);
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    const char* corpusPath = nullptr;
+    const char* writePath = nullptr;
+    size_t corpusSize = 32;
+    // Options of our own are taken out before Google Benchmark sees the rest
+    int remaining = 1;
+    for (int index = 1; index < argc; ++index)
+    {
+        const std::string_view arg = argv[index];
+        if (arg.starts_with("--corpus=")) corpusPath = argv[index] + strlen("--corpus=");
+        else if (arg.starts_with("--corpus-size=")) corpusSize = strtoul(argv[index] + strlen("--corpus-size="), nullptr, 10);
+        else if (arg.starts_with("--write-corpus=")) writePath = argv[index] + strlen("--write-corpus=");
+        else if (arg == "-h" || arg == "--help")
+        {
+            PrintUsage(argv[0]);
+            benchmark::PrintDefaultHelp();
+            return 0;
+        }
+        else argv[remaining++] = argv[index];
+    }
+    argc = remaining;
+
+    LogFile logFile;
+    std::string synthetic;
+    std::string_view data;
+    if (corpusPath)
+    {
+        if (!logFile.Open(corpusPath))
+        {
+            fprintf(stderr, "Cannot open %s : %s\n", corpusPath, strerror(errno));
+            return -1;
+        }
+        data = logFile.Data();
+    }
+    else
+    {
+        synthetic = SyntheticLogGenerator().Generate(corpusSize << 20);
+        data = synthetic;
+    }
+    if (writePath)
+    {
+        FILE* file = fopen(writePath, "wb");
+        if (!file || fwrite(data.data(), 1, data.size(), file) != data.size() || fclose(file) != 0)
+        {
+            fprintf(stderr, "Cannot write %s : %s\n", writePath, strerror(errno));
+            return -1;
+        }
+        return 0;
+    }
+
+    const Corpus corpus{data, CountLines(data)};
+    benchmark::RegisterBenchmark("EndToEnd/LineView", ParseLineViews, corpus)->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark("EndToEnd/LineInfo", ParseLineInfos, corpus)->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark("EndToEnd/KeepLineInfo", KeepLineInfos, corpus)->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark("EndToEnd/KeepPmrLineInfo", KeepPmrLineInfos, corpus)->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark("EndToEnd/Batch", ParseBatch, corpus)->Unit(benchmark::kMillisecond);
+
+    // Every line runs through the rules before the one it matches, so this is the cost of reaching and applying a rule
+    const std::map<CompilerOutputRule, std::string> ruleLines = SplitByRule(data);
+    for (const auto& [rule, lines] : ruleLines)
+    {
+        const std::string name = std::string("Rule/") + GetCompilerOutputRuleName(rule);
+        benchmark::RegisterBenchmark(name.c_str(), ParseLineViews, Corpus{lines, CountLines(lines)})->Unit(benchmark::kMicrosecond);
+    }
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return -1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,397 @@
+/*
+ * Compiler Output Parser: Parse error, warning and messages
+ * Copyright (C) 2024  Christo Joseph
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BUILD_COMMAND_HPP_INCLUDED
+#define BUILD_COMMAND_HPP_INCLUDED
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "compiler_output_parser.hpp"
+
+extern char** environ;
+
+/*
+ * A command run with its stdout and stderr going to pipes that are read through epoll, the lines of each pipe are
+ * handed out from the buffer they were read into. Everything read is first copied as it is to a passthrough file
+ * descriptor, so the build shows the same output as without log-parser. The pipes are made as large as the system
+ * allows and are drained as soon as they are readable, the command does not wait on the parsing of its lines. Nor on
+ * the passthrough: what a slow terminal or pager does not take at once is held back and written when epoll reports
+ * room for it.
+ * The command runs in a process group of its own, so that Stop() reaches the processes it started as well. Interrupt,
+ * hangup and terminate signals sent to log-parser are passed on to the group while the command runs.
+ */
+class BuildCommand
+{
+public:
+    // Past maxBacklogSize bytes of output held back for the passthrough, more is dropped and counted
+    static constexpr size_t defaultMaxBacklogSize = 64 << 20;
+
+    explicit BuildCommand(size_t maxBacklogSize = defaultMaxBacklogSize) : m_maxBacklogSize(maxBacklogSize) {}
+    BuildCommand(const BuildCommand&) = delete;
+    BuildCommand& operator=(const BuildCommand&) = delete;
+    ~BuildCommand()
+    {
+        for (Pipe& pipe : m_pipes) ClosePipe(pipe);
+        Stop();
+        // Stopped early, the output held back is still owed to the passthrough
+        while (m_backlogBegin < m_backlog.size())
+        {
+            pollfd descriptor{.fd = m_passthroughFd, .events = POLLOUT, .revents = 0};
+            if (poll(&descriptor, 1, -1) < 0 && errno != EINTR) break;
+            WriteBacklog();
+        }
+        ClosePassthrough();
+        if (m_epoll >= 0) close(m_epoll);
+    }
+
+    // argv ends with a null pointer, the command is looked up in PATH. Returns false with errno set on failure
+    bool Start(char* const argv[], int passthroughFd)
+    {
+        m_epoll = epoll_create1(EPOLL_CLOEXEC);
+        if (m_epoll < 0) return false;
+        OpenPassthrough(passthroughFd);
+        int fds[2][2];
+        if (pipe2(fds[0], O_CLOEXEC) != 0) return false;
+        if (pipe2(fds[1], O_CLOEXEC) != 0)
+        {
+            const int savedErrno = errno;
+            close(fds[0][0]);
+            close(fds[0][1]);
+            errno = savedErrno;
+            return false;
+        }
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_adddup2(&actions, fds[0][1], STDOUT_FILENO);
+        posix_spawn_file_actions_adddup2(&actions, fds[1][1], STDERR_FILENO);
+        posix_spawnattr_t attributes;
+        posix_spawnattr_init(&attributes);
+        posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+        posix_spawnattr_setpgroup(&attributes, 0);
+        const int error = posix_spawnp(&m_pid, argv[0], &actions, &attributes, argv, environ);
+        posix_spawnattr_destroy(&attributes);
+        posix_spawn_file_actions_destroy(&actions);
+        close(fds[0][1]);
+        close(fds[1][1]);
+        for (size_t i = 0; i < 2; ++i) m_pipes[i].fd = fds[i][0];
+        if (error != 0)
+        {
+            m_pid = -1;
+            for (Pipe& pipe : m_pipes) ClosePipe(pipe);
+            errno = error;
+            return false;
+        }
+        ForwardSignals(m_pid);
+        for (size_t i = 0; i < 2; ++i)
+        {
+            Pipe& pipe = m_pipes[i];
+            // Best effort, the size is capped by /proc/sys/fs/pipe-max-size
+            fcntl(pipe.fd, F_SETPIPE_SZ, pipeSize);
+            fcntl(pipe.fd, F_SETFL, fcntl(pipe.fd, F_GETFL) | O_NONBLOCK);
+            pipe.buffer.resize(initialBufferSize);
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.u32 = static_cast<uint32_t>(i);
+            if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, pipe.fd, &event) != 0) return false;
+            ++m_openPipes;
+        }
+        return true;
+    }
+
+    /*
+     * Waits for output and calls onLine(std::string_view) for every line it completes, the views are valid during the call.
+     * Returns false once both pipes are closed and the output held back is passed through, after the last lines, or on an
+     * error reported by Error().
+     */
+    template <typename OnLine>
+    bool ReadLines(OnLine&& onLine)
+    {
+        // A passthrough epoll cannot watch is left to the destructor
+        if (m_openPipes == 0 && (m_backlogBegin == m_backlog.size() || !m_passthroughWatched)) return false;
+        epoll_event events[3];
+        const int count = epoll_wait(m_epoll, events, 3, -1);
+        if (count < 0)
+        {
+            if (errno == EINTR) return true;
+            m_error = errno;
+            return false;
+        }
+        for (int i = 0; i < count; ++i)
+        {
+            if (events[i].data.u32 == passthroughEvent) WriteBacklog();
+            else ReadPipe(m_pipes[events[i].data.u32], onLine);
+        }
+        return m_error == 0;
+    }
+
+    int Error() const { return m_error; }
+
+    // Waits for the command to end, its exit status or 128 plus the signal that ended it
+    int Wait()
+    {
+        if (m_pid < 0) return m_status;
+        int status = 0;
+        while (waitpid(m_pid, &status, 0) < 0)
+        {
+            if (errno != EINTR)
+            {
+                status = -1;
+                break;
+            }
+        }
+        ForwardSignals(-1);
+        m_pid = -1;
+        m_status = status < 0 ? -1 : WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        return m_status;
+    }
+
+    // Ends the command and everything it started with SIGTERM, unless it has already ended, and waits for it
+    int Stop()
+    {
+        if (m_pid >= 0) kill(-m_pid, SIGTERM);
+        return Wait();
+    }
+
+private:
+    static constexpr int pipeSize = 1 << 20;
+    static constexpr size_t initialBufferSize = 1 << 20;
+    static constexpr uint32_t passthroughEvent = 2;
+
+    // Same layout as the buffer of LogStream, begin is the start of the partial line
+    struct Pipe
+    {
+        int fd{-1};
+        std::vector<char> buffer;
+        size_t begin{0};
+        size_t end{0};
+    };
+
+    template <typename OnLine>
+    void ReadPipe(Pipe& pipe, OnLine& onLine)
+    {
+        if (pipe.end == pipe.buffer.size())
+        {
+            if (pipe.begin == 0) pipe.buffer.resize(pipe.buffer.size() * 2);
+            std::copy(pipe.buffer.begin() + pipe.begin, pipe.buffer.begin() + pipe.end, pipe.buffer.begin());
+            pipe.end -= pipe.begin;
+            pipe.begin = 0;
+        }
+        ssize_t count;
+        do
+        {
+            count = read(pipe.fd, pipe.buffer.data() + pipe.end, pipe.buffer.size() - pipe.end);
+        } while (count < 0 && errno == EINTR);
+        if (count < 0 && errno == EAGAIN) return;
+        if (count < 0) m_error = errno;
+        if (count <= 0)
+        {
+            std::string_view line(pipe.buffer.data() + pipe.begin, pipe.end - pipe.begin);
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            if (!line.empty()) onLine(line);
+            pipe.begin = pipe.end = 0;
+            epoll_ctl(m_epoll, EPOLL_CTL_DEL, pipe.fd, nullptr);
+            ClosePipe(pipe);
+            --m_openPipes;
+            return;
+        }
+        // Passed through before the lines are handed out, they may be edited in place
+        Passthrough(pipe.buffer.data() + pipe.end, static_cast<size_t>(count));
+        const std::string_view data(pipe.buffer.data() + pipe.begin, pipe.end + static_cast<size_t>(count) - pipe.begin);
+        const size_t lastNewline = data.rfind('\n');
+        if (lastNewline != std::string_view::npos)
+        {
+            ForEachCompilerOutputLine(data.substr(0, lastNewline + 1), onLine);
+            pipe.begin += lastNewline + 1;
+        }
+        pipe.end += static_cast<size_t>(count);
+        if (pipe.begin == pipe.end) pipe.begin = pipe.end = 0;
+    }
+
+    /*
+     * Regular files are written as they are, they do not wait on a reader. Terminals, pipes and FIFOs are opened again
+     * through /proc for a nonblocking file description of their own, setting O_NONBLOCK on fd would change it for every
+     * process that shares it. Sockets are sent to with MSG_DONTWAIT. Without /proc the writes block as they used to.
+     */
+    void OpenPassthrough(int fd)
+    {
+        struct stat status;
+        if (fstat(fd, &status) != 0) return;
+        m_passthroughFd = fd;
+        if (S_ISREG(status.st_mode)) return;
+        if (S_ISSOCK(status.st_mode))
+        {
+            m_passthroughIsSocket = true;
+            return;
+        }
+        const std::string path = "/proc/self/fd/" + std::to_string(fd);
+        const int reopened = open(path.c_str(), O_WRONLY | O_NONBLOCK | O_NOCTTY | O_CLOEXEC);
+        if (reopened < 0) return;
+        m_passthroughFd = reopened;
+        m_ownsPassthrough = true;
+    }
+
+    void ClosePassthrough()
+    {
+        if (m_passthroughWatched) epoll_ctl(m_epoll, EPOLL_CTL_DEL, m_passthroughFd, nullptr);
+        if (m_ownsPassthrough) close(m_passthroughFd);
+        m_passthroughFd = -1;
+        m_passthroughWatched = m_ownsPassthrough = false;
+        m_backlog.clear();
+        m_backlogBegin = 0;
+    }
+
+    // What the passthrough does not take at once waits in the backlog, the command is never held up by it
+    void Passthrough(const char* data, size_t size)
+    {
+        if (m_passthroughFd < 0) return;
+        if (m_backlogBegin == m_backlog.size())
+        {
+            const size_t written = WritePassthrough(data, size);
+            if (written == size || m_passthroughFd < 0) return;
+            data += written;
+            size -= written;
+            WatchPassthrough(true);
+        }
+        const size_t kept = std::min(size, m_maxBacklogSize - std::min(m_maxBacklogSize, m_backlog.size() - m_backlogBegin));
+        m_backlog.insert(m_backlog.end(), data, data + kept);
+        m_droppedSize += size - kept;
+    }
+
+    void WriteBacklog()
+    {
+        if (m_passthroughFd < 0) return;
+        const size_t written = WritePassthrough(m_backlog.data() + m_backlogBegin, m_backlog.size() - m_backlogBegin);
+        if (m_passthroughFd < 0) return;
+        m_backlogBegin += written;
+        if (m_backlogBegin == m_backlog.size())
+        {
+            m_backlog.clear();
+            m_backlogBegin = 0;
+            if (m_droppedSize == 0)
+            {
+                WatchPassthrough(false);
+                return;
+            }
+            const std::string note = "log-parser: " + std::to_string(m_droppedSize) + " bytes of output were not passed through\n";
+            m_backlog.assign(note.begin(), note.end());
+            m_droppedSize = 0;
+        }
+        else if (m_backlogBegin > m_backlog.size() / 2)
+        {
+            m_backlog.erase(m_backlog.begin(), m_backlog.begin() + static_cast<ptrdiff_t>(m_backlogBegin));
+            m_backlogBegin = 0;
+        }
+    }
+
+    // Returns how much was written before the passthrough was full. One that fails (closed terminal, full disk) is given up on
+    size_t WritePassthrough(const char* data, size_t size)
+    {
+        size_t written = 0;
+        while (written < size)
+        {
+            const ssize_t count = m_passthroughIsSocket ? send(m_passthroughFd, data + written, size - written, MSG_DONTWAIT | MSG_NOSIGNAL)
+                                                        : write(m_passthroughFd, data + written, size - written);
+            if (count < 0 && errno == EINTR) continue;
+            if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            if (count <= 0)
+            {
+                ClosePassthrough();
+                break;
+            }
+            written += static_cast<size_t>(count);
+        }
+        return written;
+    }
+
+    void WatchPassthrough(bool watch)
+    {
+        if (watch == m_passthroughWatched) return;
+        epoll_event event{};
+        event.events = EPOLLOUT;
+        event.data.u32 = passthroughEvent;
+        if (epoll_ctl(m_epoll, watch ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, m_passthroughFd, &event) == 0) m_passthroughWatched = watch;
+    }
+
+    // Signals that would end log-parser end the command instead, log-parser then ends with its status
+    static void ForwardSignals(pid_t group)
+    {
+        static struct sigaction previous[3];
+        static constexpr int signals[3] = {SIGINT, SIGHUP, SIGTERM};
+        if (group >= 0 && forwardGroup < 0)
+        {
+            forwardGroup = group;
+            struct sigaction action{};
+            action.sa_handler = [](int signal)
+            {
+                const int savedErrno = errno;
+                kill(-forwardGroup, signal);
+                errno = savedErrno;
+            };
+            sigemptyset(&action.sa_mask);
+            for (size_t i = 0; i < 3; ++i)
+            {
+                // Ignored as with nohup, the command has them ignored as well
+                sigaction(signals[i], nullptr, &previous[i]);
+                if (previous[i].sa_handler != SIG_IGN) sigaction(signals[i], &action, nullptr);
+            }
+        }
+        else if (group < 0 && forwardGroup >= 0)
+        {
+            for (size_t i = 0; i < 3; ++i) sigaction(signals[i], &previous[i], nullptr);
+            forwardGroup = -1;
+        }
+    }
+
+    static void ClosePipe(Pipe& pipe)
+    {
+        if (pipe.fd >= 0) close(pipe.fd);
+        pipe.fd = -1;
+    }
+
+    static inline volatile sig_atomic_t forwardGroup{-1};
+
+    const size_t m_maxBacklogSize;
+    Pipe m_pipes[2];
+    int m_openPipes{0};
+    int m_epoll{-1};
+    int m_passthroughFd{-1};
+    bool m_ownsPassthrough{false};
+    bool m_passthroughIsSocket{false};
+    bool m_passthroughWatched{false};
+    std::vector<char> m_backlog;
+    size_t m_backlogBegin{0};
+    uint64_t m_droppedSize{0};
+    pid_t m_pid{-1};
+    int m_status{-1};
+    int m_error{0};
+};
+
+#endif  // BUILD_COMMAND_HPP_INCLUDED
@@ -19,312 +19,1316 @@
 #ifndef COMPILER_OUTPUT_PARSER_HPP_INCLUDED
 #define COMPILER_OUTPUT_PARSER_HPP_INCLUDED
 
+#if defined(COMPILER_OUTPUT_PARSER_LIB_HPP_INCLUDED) && !defined(COMPILER_OUTPUT_PARSER_LIB_BUILD)
+#error "compiler_output_parser.hpp is the header only parser, it cannot be used along with compiler_output_parser_lib.hpp"
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "compiler_output_types.hpp"
 #include "ctre.hpp"
 
-enum class CompilerOutputLineType
+#if !defined(COMPILER_OUTPUT_PARSER_NO_SIMD) && (defined(__AVX2__) || defined(__SSE2__))
+#include <immintrin.h>
+#endif
+
+// Toolchains the rules come from, used to leave out the rules of the toolchains that are not in use
+enum class CompilerOutputToolchain : uint32_t
 {
-    normal,
-    warning,
-    error,
-    info
+    none = 0,
+    gcc = 1 << 0,
+    binutils = 1 << 1,
+    mingw = 1 << 2,
+    all = gcc | binutils | mingw
 };
 
-struct CompilerOutputLineInfo
+constexpr CompilerOutputToolchain operator|(CompilerOutputToolchain lhs, CompilerOutputToolchain rhs)
 {
-    CompilerOutputLineType type;
-    std::string fileName;
-    std::string line;
-    std::string message;
-};
+    return static_cast<CompilerOutputToolchain>(static_cast<uint32_t>(lhs) | static_cast<uint32_t>(rhs));
+}
+
+constexpr CompilerOutputToolchain operator&(CompilerOutputToolchain lhs, CompilerOutputToolchain rhs)
+{
+    return static_cast<CompilerOutputToolchain>(static_cast<uint32_t>(lhs) & static_cast<uint32_t>(rhs));
+}
 
 struct CompilerRegexInfo
 {
+    CompilerOutputRule rule{CompilerOutputRule::none};
     const char* name{nullptr};
     CompilerOutputLineType type;
     size_t fileNameIdx;
     size_t lineIdx;
     size_t messageIdx;
+    CompilerOutputToolchain toolchain{CompilerOutputToolchain::gcc};
 };
 
-#define POPULATE_INFO(info, match, regexInfo)                                                                               \
-    {                                                                                                                       \
-        info.type = regexInfo.type;                                                                                         \
-        /*std::cout << "Matched : name : [" << regexInfo.name << "] type [" << static_cast<int>(regexInfo.type) << "]\n";*/ \
-        if (compilerRegexInfo.fileNameIdx) info.fileName = match.get<compilerRegexInfo.fileNameIdx>().to_string();          \
-        if (compilerRegexInfo.lineIdx) info.line = match.get<compilerRegexInfo.lineIdx>().to_string();                      \
-        if (compilerRegexInfo.messageIdx) info.message = match.get<compilerRegexInfo.messageIdx>().to_string();             \
-    }
+namespace compiler_output_parser_detail
+{
+constexpr bool IsHexOffsetChar(char c) { return IsDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F') || c == 'x' || c == 'X'; }
+constexpr bool IsAlnum(char c) { return IsDigit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
 
-inline CompilerOutputLineInfo GetCompilerOutputLineInfo(std::string_view line)
+// [{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.\-]
+inline constexpr std::array<bool, 256> fileNameChars = []
 {
-    CompilerOutputLineInfo ret;
-    //<![CDATA[FATAL:[[:blank:]]*(.*)]]>
-    if (auto m = ctre::match<"FATAL:[[:blank:]]*(.*)">(line))
-    {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "Fatal error", .type = CompilerOutputLineType::error, .fileNameIdx = 0, .lineIdx = 0, .messageIdx = 1};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
-    }
-    //<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):[[:blank:]]+([iI]n
-    //([cC]lass|[cC]onstructor|[dD]estructor|[fF]unction|[mM]ember [fF]unction).*)]]>
-    else if (auto m = ctre::match<"([{}()[:blank:]#%$~[:alnum:]!&_:+/\\\\\\.\\-]{1,512}):[[:blank:]]+([iI]n "
-                                  "([cC]lass|[cC]onstructor|[dD]estructor|[fF]unction|[mM]ember [fF]unction).*)">(line))
+    std::array<bool, 256> table{};
+    for (unsigned char c = '0'; c <= '9'; ++c) table[c] = true;
+    for (unsigned char c = 'a'; c <= 'z'; ++c) table[c] = true;
+    for (unsigned char c = 'A'; c <= 'Z'; ++c) table[c] = true;
+    for (char c : std::string_view("{}() \t#%$~!&_:+/\\.-")) table[static_cast<unsigned char>(c)] = true;
+    return table;
+}();
+
+constexpr bool IsFileNameChar(char c) { return fileNameChars[static_cast<unsigned char>(c)]; }
+
+// [[:blank:]A-Za-z0-9_:+/\.-] , the source file name of "Linker error (2)"
+constexpr bool IsLinkerFileNameChar(char c)
+{
+    return IsAlnum(c) || IsBlank(c) || c == '_' || c == ':' || c == '+' || c == '/' || c == '.' || c == '-';
+}
+
+// What follows the ':' that ends the file name
+enum class LocationForm
+{
+    file,            // file:
+    fileLine,        // file:line:
+    fileLineColumn,  // file:line:column:
+    textOffset       // file:(.text+0x1a):
+};
+
+// What separates the location from the message
+enum class LocationSeparator
+{
+    none,
+    blank,  // [[:blank:]]
+    blanks  // [[:blank:]]+ , none of the messages matched after it start with a blank
+};
+
+struct Location
+{
+    std::string_view fileName;
+    std::string_view line;
+    std::string_view column;
+    std::string_view message;
+};
+
+/*
+ * Most rules start with the same "file:line[:column]:" prefix. Its file name is greedy and may itself contain ':', so the
+ * regex engine used to retry every ':' of the prefix for every rule. The prefix is scanned once here and each rule then
+ * tries the recorded ':' from the last one backwards, which keeps the longest-file-name-first results of the patterns.
+ * The numbers, blanks and message starts that a rule checks after a ':' stop at the next ':', so trying all of them is
+ * linear in the length of the line and file names need no length limit.
+ */
+class LocationPrefix
+{
+public:
+    // The ':' positions are kept in storage shared by the thread, only one LocationPrefix per thread may be in use
+    explicit LocationPrefix(std::string_view line) : m_line(line), m_colons(ColonStorage())
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "'In function...' info", .type = CompilerOutputLineType::info, .fileNameIdx = 1, .lineIdx = 0, .messageIdx = 2};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        m_colons.clear();
+        for (size_t i = 0; i < line.size() && IsFileNameChar(line[i]); ++i)
+        {
+            if (line[i] == ':' && i > 0) m_colons.push_back(i);
+        }
     }
-    //<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):([0-9]+):[0-9]+:[[:blank:]]+(\[[[:blank:]]+[Ss]kipping [0-9]+ instantiation
-    // contexts[[:blank:]]+\])]]>
-    else if (auto m = ctre::match<"([{}()[:blank:]#%$~[:alnum:]!&_:+/\\\\\\.\\-]{1,512}):([0-9]+):[0-9]+:[[:blank:]]+(\\[[[:blank:]]+[Ss]kipping "
-                                  "[0-9]+ instantiation contexts[[:blank:]]+\\])">(line))
+
+    LocationPrefix(const LocationPrefix&) = delete;
+    LocationPrefix& operator=(const LocationPrefix&) = delete;
+
+    // (file):<form>:<separator>(message), the file name starting at fileNameBegin
+    template <typename MessagePredicate>
+    bool Match(LocationForm form, LocationSeparator separator, MessagePredicate&& messagePredicate, Location& location,
+               size_t fileNameBegin = 0) const
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {.name = "'Skipping N instantiation contexts' info (2)",
-                                                                .type = CompilerOutputLineType::info,
-                                                                .fileNameIdx = 1,
-                                                                .lineIdx = 2,
-                                                                .messageIdx = 3};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        for (size_t i = m_colons.size(); i-- > 0 && m_colons[i] > fileNameBegin;)
+        {
+            if (Resolve(fileNameBegin, m_colons[i], form, separator, location) && messagePredicate(location.message)) return true;
+        }
+        return false;
     }
-    //<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):([0-9]+):[[:blank:]]+(\[[[:blank:]]+[Ss]kipping [0-9]+ instantiation
-    // contexts[[:blank:]]+\])]]>
-    else if (auto m = ctre::match<"([{}()[:blank:]#%$~[:alnum:]!&_:+/\\\\\\.\\-]{1,512}):([0-9]+):[[:blank:]]+(\\[[[:blank:]]+[Ss]kipping "
-                                  "[0-9]+ instantiation contexts[[:blank:]]+\\])">(line))
+
+    /*
+     * [...]\.o:(file):<form>:<separator>(message), the object file name is not captured. What follows the file name does
+     * not depend on where it starts, so the last ':' that resolves is the one the pattern ends the file name with, and the
+     * object file name is the longest one before it.
+     */
+    template <typename MessagePredicate>
+    bool MatchInObject(LocationForm form, LocationSeparator separator, MessagePredicate&& messagePredicate, Location& location) const
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {.name = "'Skipping N instantiation contexts' info",
-                                                                .type = CompilerOutputLineType::info,
-                                                                .fileNameIdx = 1,
-                                                                .lineIdx = 2,
-                                                                .messageIdx = 3};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        for (size_t j = m_colons.size(); j-- > 0;)
+        {
+            const size_t colon = m_colons[j];
+            if (!Resolve(0, colon, form, separator, location) || !messagePredicate(location.message)) continue;
+            for (size_t i = j; i-- > 0;)
+            {
+                const size_t objectColon = m_colons[i];
+                if (objectColon >= 3 && objectColon + 1 < colon && m_line.substr(objectColon - 2, 2) == ".o")
+                {
+                    location.fileName = m_line.substr(objectColon + 1, colon - objectColon - 1);
+                    return true;
+                }
+            }
+            return false;
+        }
+        return false;
     }
-    //<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):[[:blank:]]+([Ii]n [Ii]nstantiation.*)]]>
-    else if (auto m = ctre::match<"([{}()[:blank:]#%$~[:alnum:]!&_:+/\\\\\\.\\-]{1,512}):[[:blank:]]+([Ii]n [Ii]nstantiation.*)">(line))
+
+private:
+    bool Resolve(size_t fileNameBegin, size_t colon, LocationForm form, LocationSeparator separator, Location& location) const
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "'In instantiation' warning", .type = CompilerOutputLineType::warning, .fileNameIdx = 1, .lineIdx = 0, .messageIdx = 2};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        location = {};
+        location.fileName = m_line.substr(fileNameBegin, colon - fileNameBegin);
+        size_t pos = colon + 1;
+        switch (form)
+        {
+            case LocationForm::file:
+                break;
+            case LocationForm::fileLine:
+            case LocationForm::fileLineColumn:
+                if (!ConsumeNumber(pos, location.line)) return false;
+                if (form == LocationForm::fileLineColumn && !ConsumeNumber(pos, location.column)) return false;
+                break;
+            case LocationForm::textOffset:
+            {
+                if (m_line.substr(pos, 7) != "(.text+") return false;
+                pos += 7;
+                const size_t offsetBegin = pos;
+                while (pos < m_line.size() && IsHexOffsetChar(m_line[pos])) ++pos;
+                if (pos == offsetBegin || m_line.substr(pos, 2) != "):") return false;
+                pos += 2;
+                break;
+            }
+        }
+        switch (separator)
+        {
+            case LocationSeparator::none:
+                break;
+            case LocationSeparator::blank:
+                if (pos >= m_line.size() || !IsBlank(m_line[pos])) return false;
+                ++pos;
+                break;
+            case LocationSeparator::blanks:
+                if (pos >= m_line.size() || !IsBlank(m_line[pos])) return false;
+                while (pos < m_line.size() && IsBlank(m_line[pos])) ++pos;
+                break;
+        }
+        location.message = m_line.substr(pos);
+        return true;
     }
-    //<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):([0-9]+):[0-9]+:[[:blank:]]+([Rr]equired from.*)]]>
-    else if (auto m = ctre::match<"([{}()[:blank:]#%$~[:alnum:]!&_:+/\\\\\\.\\-]{1,512}):([0-9]+):[0-9]+:[[:blank:]]+([Rr]equired from.*)">(line))
+
+    // ([0-9]+):
+    bool ConsumeNumber(size_t& pos, std::string_view& number) const
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "'Required from' warning", .type = CompilerOutputLineType::warning, .fileNameIdx = 1, .lineIdx = 2, .messageIdx = 3};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        const size_t begin = pos;
+        while (pos < m_line.size() && IsDigit(m_line[pos])) ++pos;
+        if (pos == begin || pos >= m_line.size() || m_line[pos] != ':') return false;
+        number = m_line.substr(begin, pos - begin);
+        ++pos;
+        return true;
     }
-    //<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):([0-9]+):[0-9]+:[[:blank:]]+([Ii]nstantiated from .*)]]>
-    else if (auto m =
-                 ctre::match<"([{}()[:blank:]#%$~[:alnum:]!&_:+/\\\\\\.\\-]{1,512}):([0-9]+):[0-9]+:[[:blank:]]+([Ii]nstantiated from .*)">(line))
+
+    static std::vector<size_t>& ColonStorage()
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "'Instantiated from' info (2)", .type = CompilerOutputLineType::info, .fileNameIdx = 1, .lineIdx = 2, .messageIdx = 3};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        thread_local std::vector<size_t> colons;
+        return colons;
     }
-    //<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):([0-9]+):[[:blank:]]+([Ii]nstantiated from .*)]]>
-    else if (auto m = ctre::match<"([{}()[:blank:]#%$~[:alnum:]!&_:+/\\\\\\.\\-]{1,512}):([0-9]+):[[:blank:]]+([Ii]nstantiated from .*)">(line))
+
+    std::string_view m_line;
+    std::vector<size_t>& m_colons;
+};
+
+/*
+ * Every rule needs a ':' and the rules that are not location rules also need a literal next to one of them. Most lines
+ * of a build log are command lines and progress lines without any of these, so the ':' are located with SIMD and the
+ * literals around them are collected in a mask of anchors. A rule is only tried when its anchor was found.
+ */
+enum Anchor : uint32_t
+{
+    anchorLocation = 1 << 0,              // ':' that may end a file name at the start of the line
+    anchorFatal = 1 << 1,                 // ^FATAL:
+    anchorWindres = 1 << 2,               // ^windres.exe:
+    anchorNote = 1 << 3,                  // [Nn]ote:[[:blank:]]
+    anchorError = 1 << 4,                 // [Ee]rror:[[:blank:]]
+    anchorWarning = 1 << 5,               // [Ww]arning:[[:blank:]]
+    anchorInfo = 1 << 6,                  // [Ii]nfo:[[:blank:]]
+    anchorTextOffset = 1 << 7,            // ):
+    anchorCannotFind = 1 << 8,            // :[[:blank:]]cannot find
+    anchorCannotOpenOutputFile = 1 << 9,  // :[[:blank:]]cannot open output file
+    anchorUnrecognized = 1 << 10,         // :[[:blank:]][Uu]nrecognized
+    anchorNoSuchFile = 1 << 11            // :[[:blank:]]No such file or directory
+};
+
+// [Xx]word ending right before pos
+constexpr bool EndsWithWord(std::string_view line, size_t pos, char upper, std::string_view word)
+{
+    if (pos < word.size() + 1) return false;
+    const char first = line[pos - word.size() - 1];
+    return (first == upper || first == upper - 'A' + 'a') && line.substr(pos - word.size(), word.size()) == word;
+}
+
+inline uint32_t ColonAnchors(std::string_view line, size_t colon)
+{
+    uint32_t anchors = 0;
+    if (colon > 0 && IsFileNameChar(line[0])) anchors |= anchorLocation;
+    if (colon == 5 && line.starts_with("FATAL")) anchors |= anchorFatal;
+    if (colon == 11 && line.starts_with("windres.exe")) anchors |= anchorWindres;
+    if (colon > 0 && line[colon - 1] == ')') anchors |= anchorTextOffset;
+    if (colon + 1 < line.size() && IsBlank(line[colon + 1]))
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "'Instantiated from' info", .type = CompilerOutputLineType::info, .fileNameIdx = 1, .lineIdx = 2, .messageIdx = 3};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        if (EndsWithWord(line, colon, 'N', "ote")) anchors |= anchorNote;
+        if (EndsWithWord(line, colon, 'E', "rror")) anchors |= anchorError;
+        if (EndsWithWord(line, colon, 'W', "arning")) anchors |= anchorWarning;
+        if (EndsWithWord(line, colon, 'I', "nfo")) anchors |= anchorInfo;
+        const std::string_view rest = line.substr(colon + 2);
+        if (rest.starts_with("cannot find")) anchors |= anchorCannotFind;
+        if (rest.starts_with("cannot open output file")) anchors |= anchorCannotOpenOutputFile;
+        if (rest.starts_with("unrecognized") || rest.starts_with("Unrecognized")) anchors |= anchorUnrecognized;
+        if (rest.starts_with("No such file or directory")) anchors |= anchorNoSuchFile;
     }
-    //<![CDATA[windres.exe:[[:blank:]]([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):([0-9]+):[[:blank:]](.*)]]>
-    else if (auto m = ctre::match<"windres.exe:[[:blank:]]([{}()[:blank:]#%$~[:alnum:]!&_:+/\\\\\\.\\-]{1,512}):([0-9]+):[[:blank:]](.*)">(line))
+    return anchors;
+}
+
+inline uint32_t FindAnchors(std::string_view line)
+{
+    uint32_t anchors = 0;
+    size_t pos = 0;
+    const char* data = line.data();
+#if !defined(COMPILER_OUTPUT_PARSER_NO_SIMD) && defined(__AVX2__)
+    const __m256i colons256 = _mm256_set1_epi8(':');
+    for (; pos + 32 <= line.size(); pos += 32)
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "Resource compiler error", .type = CompilerOutputLineType::error, .fileNameIdx = 1, .lineIdx = 2, .messageIdx = 3};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+        for (uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, colons256))); mask; mask &= mask - 1)
+        {
+            anchors |= ColonAnchors(line, pos + std::countr_zero(mask));
+        }
     }
-    //<![CDATA[windres.exe:[[:blank:]](.*)]]>
-    else if (auto m = ctre::match<"windres.exe:[[:blank:]](.*)">(line))
+#endif
+#if !defined(COMPILER_OUTPUT_PARSER_NO_SIMD) && defined(__SSE2__)
+    const __m128i colons128 = _mm_set1_epi8(':');
+    for (; pos + 16 <= line.size(); pos += 16)
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "Resource compiler error (2)", .type = CompilerOutputLineType::error, .fileNameIdx = 0, .lineIdx = 0, .messageIdx = 1};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        for (uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, colons128))); mask; mask &= mask - 1)
+        {
+            anchors |= ColonAnchors(line, pos + std::countr_zero(mask));
+        }
     }
-    //<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):([0-9]+):([0-9]+):[[:blank:]]([Ww]arning:[[:blank:]].*)]]>
-    else if (auto m =
-                 ctre::match<"([{}()[:blank:]#%$~[:alnum:]!&_:+/\\\\\\.\\-]{1,512}):([0-9]+):([0-9]+):[[:blank:]]([Ww]arning:[[:blank:]].*)">(line))
+#endif
+    for (; pos < line.size(); ++pos)
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "Preprocessor warning", .type = CompilerOutputLineType::warning, .fileNameIdx = 1, .lineIdx = 2, .messageIdx = 4};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        if (data[pos] == ':') anchors |= ColonAnchors(line, pos);
     }
-    //<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):([0-9]+):[0-9]+:[[:blank:]]([Nn]ote:[[:blank:]].*)]]>
-    else if (auto m = ctre::match<"([{}()[:blank:]#%$~[:alnum:]!&_:+/\\\\\\.\\-]{1,512}):([0-9]+):[0-9]+:[[:blank:]]([Nn]ote:[[:blank:]].*)">(line))
+    return anchors;
+}
+
+inline void PopulateInfo(CompilerOutputLineView& info, const Location& location, const CompilerRegexInfo& regexInfo)
+{
+    info.type = regexInfo.type;
+    info.rule = regexInfo.rule;
+    if (regexInfo.fileNameIdx) info.fileName = location.fileName;
+    if (regexInfo.lineIdx) info.line = ParseNumber(location.line);
+    if (!location.column.empty()) info.column = ParseNumber(location.column);
+    if (regexInfo.messageIdx) info.message = location.message;
+}
+}  // namespace compiler_output_parser_detail
+
+namespace compiler_output_parser_detail
+{
+struct LineContext
+{
+    std::string_view line;
+    uint32_t anchors;
+    LocationPrefix prefix;
+};
+
+struct AnyMessage
+{
+    static bool Matches(std::string_view) { return true; }
+};
+
+template <ctll::fixed_string Pattern>
+struct MessageStartsWith
+{
+    static bool Matches(std::string_view message) { return bool(ctre::starts_with<Pattern>(message)); }
+};
+
+template <ctll::fixed_string Pattern>
+struct MessageMatches
+{
+    static bool Matches(std::string_view message) { return bool(ctre::match<Pattern>(message)); }
+};
+
+// String literal usable as a template argument
+template <size_t N>
+struct Literal
+{
+    constexpr Literal(const char (&text)[N]) { std::copy_n(text, N, m_text); }
+    constexpr std::string_view View() const { return {m_text, N - 1}; }
+
+    char m_text[N];
+};
+
+// Prefix.*Suffix
+template <Literal Prefix, Literal Suffix>
+struct MessageStartsAndEndsWith
+{
+    static bool Matches(std::string_view message)
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "Compiler note (2)", .type = CompilerOutputLineType::info, .fileNameIdx = 1, .lineIdx = 2, .messageIdx = 3};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        return message.size() >= Prefix.View().size() + Suffix.View().size() && message.starts_with(Prefix.View()) &&
+               message.ends_with(Suffix.View());
     }
-    //<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):([0-9]+):[[:blank:]]([Nn]ote:[[:blank:]].*)]]>
-    else if (auto m = ctre::match<"([{}()[:blank:]#%$~[:alnum:]!&_:+/\\\\\\.\\-]{1,512}):([0-9]+):[[:blank:]]([Nn]ote:[[:blank:]].*)">(line))
+};
+
+// Whole line pattern, fields are taken from the capture groups named by the CompilerRegexInfo of the rule
+template <ctll::fixed_string Pattern, uint32_t RequiredAnchors>
+struct RegexRule
+{
+    static constexpr bool fileNameStartsLine = false;
+
+    template <const CompilerRegexInfo& info>
+    static bool Apply(const LineContext& context, CompilerOutputLineView& view)
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "Compiler note", .type = CompilerOutputLineType::info, .fileNameIdx = 1, .lineIdx = 2, .messageIdx = 3};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        if (!(context.anchors & RequiredAnchors)) return false;
+        auto m = ctre::match<Pattern>(context.line);
+        if (!m) return false;
+        if constexpr (info.fileNameIdx) view.fileName = m.template get<info.fileNameIdx>().to_view();
+        if constexpr (info.lineIdx) view.line = ParseNumber(m.template get<info.lineIdx>().to_view());
+        if constexpr (info.messageIdx) view.message = m.template get<info.messageIdx>().to_view();
+        return true;
     }
-    //<![CDATA[([Nn]ote:[[:blank:]].*)]]>
-    else if (auto m = ctre::match<".{0,1023}([Nn]ote:[[:blank:]].*)">(line))
+};
+
+// (file):<form>:<separator>(message) using the shared LocationPrefix
+template <LocationForm Form, LocationSeparator Separator, typename Message>
+struct LocationRule
+{
+    // Lines that do not start with a file prefix cannot give a file name that does
+    static constexpr bool fileNameStartsLine = true;
+
+    template <const CompilerRegexInfo& info>
+    static bool Apply(const LineContext& context, CompilerOutputLineView& view)
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "General note", .type = CompilerOutputLineType::info, .fileNameIdx = 0, .lineIdx = 0, .messageIdx = 1};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        Location location;
+        if (!context.prefix.Match(Form, Separator, Message::Matches, location)) return false;
+        PopulateInfo(view, location, info);
+        return true;
     }
-    //<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):([0-9]+):[0-9]+:[[:blank:]](.*)]]>
-    else if (auto m = ctre::match<"([{}()[:blank:]#%$~[:alnum:]!&_:+/\\\\\\.\\-]{1,512}):([0-9]+):[0-9]+:[[:blank:]](.*)">(line))
+};
+
+// [...]\.o:(file):<form>:<separator>(message)
+template <LocationForm Form, LocationSeparator Separator, typename Message>
+struct ObjectLocationRule
+{
+    static constexpr bool fileNameStartsLine = false;
+
+    template <const CompilerRegexInfo& info>
+    static bool Apply(const LineContext& context, CompilerOutputLineView& view)
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "Preprocessor error", .type = CompilerOutputLineType::error, .fileNameIdx = 1, .lineIdx = 2, .messageIdx = 3};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        Location location;
+        if (!context.prefix.MatchInObject(Form, Separator, Message::Matches, location)) return false;
+        PopulateInfo(view, location, info);
+        return true;
     }
-    //<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):([0-9]+):[0-9]+:[[:blank:]]([Ww]arning:[[:blank:]].*)]]>
-    else if (auto m =
-                 ctre::match<"([{}()[:blank:]#%$~[:alnum:]!&_:+/\\\\\\.\\-]{1,512}):([0-9]+):[0-9]+:[[:blank:]]([Ww]arning:[[:blank:]].*)">(line))
+};
+
+// windres.exe:[[:blank:]](file):<form>:<separator>(message)
+template <LocationForm Form, LocationSeparator Separator, typename Message>
+struct WindresLocationRule
+{
+    static constexpr bool fileNameStartsLine = false;
+
+    template <const CompilerRegexInfo& info>
+    static bool Apply(const LineContext& context, CompilerOutputLineView& view)
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "Compiler warning (2)", .type = CompilerOutputLineType::warning, .fileNameIdx = 1, .lineIdx = 2, .messageIdx = 3};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        constexpr size_t fileNameBegin = std::string_view("windres.exe:").size() + 1;
+        if (!(context.anchors & anchorWindres) || context.line.size() < fileNameBegin || !IsBlank(context.line[fileNameBegin - 1])) return false;
+        Location location;
+        if (!context.prefix.Match(Form, Separator, Message::Matches, location, fileNameBegin)) return false;
+        PopulateInfo(view, location, info);
+        return true;
     }
-    //<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):([0-9]+):[[:blank:]]([Ww]arning:[[:blank:]].*)]]>
-    else if (auto m = ctre::match<"([{}()[:blank:]#%$~[:alnum:]!&_:+/\\\\\\.\\-]{1,512}):([0-9]+):[[:blank:]]([Ww]arning:[[:blank:]].*)">(line))
+};
+
+/*
+ * The rules that start with .* are matched from their anchor literal backwards instead: the greedy .* makes the pattern
+ * pick the last place its literal occurs, which a reverse search finds in one pass over the line. Find fills the
+ * location as the capture groups of the pattern would.
+ */
+template <uint32_t RequiredAnchors, bool (*Find)(std::string_view, Location&)>
+struct AnchorRule
+{
+    static constexpr bool fileNameStartsLine = false;
+
+    template <const CompilerRegexInfo& info>
+    static bool Apply(const LineContext& context, CompilerOutputLineView& view)
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "Compiler warning", .type = CompilerOutputLineType::warning, .fileNameIdx = 1, .lineIdx = 2, .messageIdx = 3};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        if (!(context.anchors & RequiredAnchors)) return false;
+        Location location;
+        if (!Find(context.line, location)) return false;
+        PopulateInfo(view, location, info);
+        return true;
     }
-    //<![CDATA[[][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+\.o:([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):([0-9]+):[[:blank:]](undefined
-    // reference.*)]]>
-    else if (auto m = ctre::match<"[{}()[:blank:]#%$~[:alnum:]!&_:+/\\\\\\.\\-]{1,512}\\.o:([{}()[:blank:]#%$~[:alnum:]!&_:+/"
-                                  "\\\\\\.\\-]{1,512}):([0-9]+):[[:blank:]](undefined reference.*)">(line))
+};
+
+// The last ':' before end followed by a blank and literal, npos if there is none
+inline size_t FindLastColonBlank(std::string_view line, size_t end, std::string_view literal)
+{
+    for (size_t colon = std::min(end, line.size()); colon-- > 0;)
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "Undefined reference (2)", .type = CompilerOutputLineType::error, .fileNameIdx = 1, .lineIdx = 2, .messageIdx = 3};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        if (line[colon] == ':' && colon + 1 < line.size() && IsBlank(line[colon + 1]) && line.substr(colon + 2).starts_with(literal)) return colon;
     }
-    //<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):([0-9]+):[0-9]+:[[:blank:]](.*)]]>
-    else if (auto m = ctre::match<"([{}()[:blank:]#%$~[:alnum:]!&_:+/\\\\\\.\\-]{1,512}):([0-9]+):[0-9]+:[[:blank:]](.*)">(line))
+    return std::string_view::npos;
+}
+
+// .*([Xx]word:[[:blank:]].*)
+inline bool FindLastWordMessage(std::string_view line, char upper, std::string_view word, Location& location)
+{
+    for (size_t colon = line.size(); colon-- > 0;)
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "Compiler error (2)", .type = CompilerOutputLineType::error, .fileNameIdx = 1, .lineIdx = 2, .messageIdx = 3};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        if (line[colon] == ':' && colon + 1 < line.size() && IsBlank(line[colon + 1]) && EndsWithWord(line, colon, upper, word))
+        {
+            location.message = line.substr(colon - word.size() - 1);
+            return true;
+        }
     }
-    //<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):([0-9]+):[[:blank:]](.*)]]>
-    else if (auto m = ctre::match<"([{}()[:blank:]#%$~[:alnum:]!&_:+/\\\\\\.\\-]{1,512}):([0-9]+):[[:blank:]](.*)">(line))
+    return false;
+}
+
+inline bool FindNoteMessage(std::string_view line, Location& location) { return FindLastWordMessage(line, 'N', "ote", location); }
+inline bool FindErrorMessage(std::string_view line, Location& location) { return FindLastWordMessage(line, 'E', "rror", location); }
+inline bool FindWarningMessage(std::string_view line, Location& location) { return FindLastWordMessage(line, 'W', "arning", location); }
+
+// (.*[Ii]nfo:[[:blank:]].*)\(auto-import\)
+inline bool FindAutoImportMessage(std::string_view line, Location& location)
+{
+    constexpr std::string_view suffix = "(auto-import)";
+    if (!line.ends_with(suffix)) return false;
+    const std::string_view message = line.substr(0, line.size() - suffix.size());
+    for (size_t colon = message.size(); colon-- > 0;)
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "Compiler error", .type = CompilerOutputLineType::error, .fileNameIdx = 1, .lineIdx = 2, .messageIdx = 3};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        if (line[colon] == ':' && colon + 1 < message.size() && IsBlank(line[colon + 1]) && EndsWithWord(line, colon, 'I', "nfo"))
+        {
+            location.message = message;
+            return true;
+        }
     }
-    //<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):\(\.text\+[0-9a-fA-FxX]+\):[[:blank:]]([Ww]arning:[[:blank:]].*)]]>
-    else if (auto m = ctre::match<"([{}()[:blank:]#%$~[:alnum:]!&_:+/"
-                                  "\\\\\\.\\-]{1,512}):\\(\\.text\\+[0-9a-fA-FxX]+\\):[[:blank:]]([Ww]arning:[[:blank:]].*)">(line))
+    return false;
+}
+
+// .*(ld.*):[[:blank:]](literal.*)
+inline bool FindLinkerMessage(std::string_view line, std::string_view literal, Location& location)
+{
+    const size_t colon = FindLastColonBlank(line, line.size(), literal);
+    if (colon == std::string_view::npos) return false;
+    const size_t linker = line.substr(0, colon).rfind("ld");
+    if (linker == std::string_view::npos) return false;
+    location.fileName = line.substr(linker, colon - linker);
+    location.message = line.substr(colon + 2);
+    return true;
+}
+
+inline bool FindCannotFindMessage(std::string_view line, Location& location) { return FindLinkerMessage(line, "cannot find", location); }
+
+inline bool FindLinkerUnrecognizedOptionMessage(std::string_view line, Location& location)
+{
+    return FindLinkerMessage(line, "unrecognized option", location);
+}
+
+// .*(ld.*):[[:blank:]](cannot open output file.*):[[:blank:]](.*) , the reason after the last ':' is not captured
+inline bool FindCannotOpenOutputFileMessage(std::string_view line, Location& location)
+{
+    constexpr std::string_view literal = "cannot open output file";
+    const size_t reasonColon = FindLastColonBlank(line, line.size(), {});
+    if (reasonColon == std::string_view::npos || reasonColon < literal.size() + 2) return false;
+    const size_t colon = FindLastColonBlank(line, reasonColon - literal.size() - 1, literal);
+    if (colon == std::string_view::npos) return false;
+    const size_t linker = line.substr(0, colon).rfind("ld");
+    if (linker == std::string_view::npos) return false;
+    location.fileName = line.substr(linker, colon - linker);
+    location.message = line.substr(colon + 2, reasonColon - colon - 2);
+    return true;
+}
+
+// .*cc.*:[[:blank:]]([Uu]nrecognized.*option.*)
+inline bool FindCompilerUnrecognizedOptionMessage(std::string_view line, Location& location)
+{
+    // ":[[:blank:]][Uu]nrecognized" ends before the last "option"
+    const size_t option = line.rfind("option");
+    if (option == std::string_view::npos || option < 14) return false;
+    for (size_t colon = option - 13; colon-- > 0;)
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "Linker warning", .type = CompilerOutputLineType::warning, .fileNameIdx = 1, .lineIdx = 0, .messageIdx = 2};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        const std::string_view rest = line.substr(colon + 2);
+        if (line[colon] != ':' || !IsBlank(line[colon + 1]) || !(rest.starts_with("unrecognized") || rest.starts_with("Unrecognized"))) continue;
+        if (line.substr(0, colon).find("cc") == std::string_view::npos) return false;
+        location.message = rest;
+        return true;
     }
-    //<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):([0-9]+):[0-9]+:[[:blank:]](.*)]]>
-    else if (auto m = ctre::match<"([{}()[:blank:]#%$~[:alnum:]!&_:+/\\\\\\.\\-]{1,512}):([0-9]+):[0-9]+:[[:blank:]](.*)">(line))
+    return false;
+}
+
+// .*:(.*):[[:blank:]](No such file or directory.*)
+inline bool FindNoSuchFileMessage(std::string_view line, Location& location)
+{
+    const size_t colon = FindLastColonBlank(line, line.size(), "No such file or directory");
+    if (colon == std::string_view::npos || colon == 0) return false;
+    const size_t fileNameColon = line.rfind(':', colon - 1);
+    if (fileNameColon == std::string_view::npos) return false;
+    location.fileName = line.substr(fileNameColon + 1, colon - fileNameColon - 1);
+    location.message = line.substr(colon + 2);
+    return true;
+}
+
+/*
+ * [...]\(.text\+[0-9A-Za-z]+\):([[:blank:]A-Za-z0-9_:+/\.-]+):[[:blank:]](.*) , the object file name running from the
+ * start of the line. The "(.text+" candidates are tried from the last one, each source file name stops at the next
+ * parenthesis, so no character is looked at twice.
+ */
+inline bool FindLinkerError2Message(std::string_view line, Location& location)
+{
+    size_t objectEnd = 0;
+    while (objectEnd < line.size() && IsFileNameChar(line[objectEnd])) ++objectEnd;
+    for (size_t open = objectEnd; open-- > 1;)
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "Linker error", .type = CompilerOutputLineType::error, .fileNameIdx = 1, .lineIdx = 2, .messageIdx = 3};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        if (line[open] != '(' || open + 7 > line.size() || line.substr(open + 2, 5) != "text+") continue;
+        size_t pos = open + 7;
+        while (pos < line.size() && IsAlnum(line[pos])) ++pos;
+        if (pos == open + 7 || line.substr(pos, 2) != "):") continue;
+        const size_t fileNameBegin = pos + 2;
+        size_t fileNameRunEnd = fileNameBegin;
+        while (fileNameRunEnd < line.size() && IsLinkerFileNameChar(line[fileNameRunEnd])) ++fileNameRunEnd;
+        for (size_t colon = fileNameRunEnd; colon-- > fileNameBegin + 1;)
+        {
+            if (line[colon] == ':' && colon + 1 < line.size() && IsBlank(line[colon + 1]))
+            {
+                location.fileName = line.substr(fileNameBegin, colon - fileNameBegin);
+                location.message = line.substr(colon + 2);
+                return true;
+            }
+        }
     }
-    //<![CDATA[[][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+\(.text\+[0-9A-Za-z]+\):([[:blank:]A-Za-z0-9_:+/\.-]+):[[:blank:]](.*)]]>
-    else if (auto m = ctre::match<"[{}()[:blank:]#%$~[:alnum:]!&_:+/\\\\\\.\\-]{1,512}\\(.text\\+[0-9A-Za-z]+\\):([[:blank:]A-Za-z0-9_:+/"
-                                  "\\.\\-]{1,512}):[[:blank:]](.*)">(line))
+    return false;
+}
+}  // namespace compiler_output_parser_detail
+
+/*
+ * The rules, translated from the Code::Blocks compiler XML. Each rule pairs its pattern with its CompilerRegexInfo, the
+ * order of DefaultCompilerOutputRuleSet is the order in which they are tried.
+ */
+namespace compiler_output_rules
+{
+using namespace compiler_output_parser_detail;
+
+//<![CDATA[FATAL:[[:blank:]]*(.*)]]>
+struct FatalError : RegexRule<"FATAL:[[:blank:]]*(.*)", anchorFatal>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::fatalError,
+                                               .name = "Fatal error",
+                                               .type = CompilerOutputLineType::error,
+                                               .fileNameIdx = 0,
+                                               .lineIdx = 0,
+                                               .messageIdx = 1,
+                                               .toolchain = CompilerOutputToolchain::gcc};
+};
+
+//<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):[[:blank:]]+([iI]n
+//([cC]lass|[cC]onstructor|[dD]estructor|[fF]unction|[mM]ember [fF]unction).*)]]>
+struct InFunctionInfo
+    : LocationRule<LocationForm::file, LocationSeparator::blanks,
+                   MessageStartsWith<"[iI]n ([cC]lass|[cC]onstructor|[dD]estructor|[fF]unction|[mM]ember [fF]unction)">>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::inFunctionInfo,
+                                               .name = "'In function...' info",
+                                               .type = CompilerOutputLineType::info,
+                                               .fileNameIdx = 1,
+                                               .lineIdx = 0,
+                                               .messageIdx = 2,
+                                               .toolchain = CompilerOutputToolchain::gcc};
+};
+
+//<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):([0-9]+):[0-9]+:[[:blank:]]+(\[[[:blank:]]+[Ss]kipping [0-9]+ instantiation
+// contexts[[:blank:]]+\])]]>
+struct SkippingInstantiationContextsInfo2
+    : LocationRule<LocationForm::fileLineColumn, LocationSeparator::blanks,
+                   MessageMatches<"\\[[[:blank:]]+[Ss]kipping [0-9]+ instantiation contexts[[:blank:]]+\\]">>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::skippingInstantiationContextsInfo2,
+                                               .name = "'Skipping N instantiation contexts' info (2)",
+                                               .type = CompilerOutputLineType::info,
+                                               .fileNameIdx = 1,
+                                               .lineIdx = 2,
+                                               .messageIdx = 3,
+                                               .toolchain = CompilerOutputToolchain::gcc};
+};
+
+//<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):([0-9]+):[[:blank:]]+(\[[[:blank:]]+[Ss]kipping [0-9]+ instantiation
+// contexts[[:blank:]]+\])]]>
+struct SkippingInstantiationContextsInfo
+    : LocationRule<LocationForm::fileLine, LocationSeparator::blanks,
+                   MessageMatches<"\\[[[:blank:]]+[Ss]kipping [0-9]+ instantiation contexts[[:blank:]]+\\]">>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::skippingInstantiationContextsInfo,
+                                               .name = "'Skipping N instantiation contexts' info",
+                                               .type = CompilerOutputLineType::info,
+                                               .fileNameIdx = 1,
+                                               .lineIdx = 2,
+                                               .messageIdx = 3,
+                                               .toolchain = CompilerOutputToolchain::gcc};
+};
+
+//<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):[[:blank:]]+([Ii]n [Ii]nstantiation.*)]]>
+struct InInstantiationWarning : LocationRule<LocationForm::file, LocationSeparator::blanks, MessageStartsWith<"[Ii]n [Ii]nstantiation">>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::inInstantiationWarning,
+                                               .name = "'In instantiation' warning",
+                                               .type = CompilerOutputLineType::warning,
+                                               .fileNameIdx = 1,
+                                               .lineIdx = 0,
+                                               .messageIdx = 2,
+                                               .toolchain = CompilerOutputToolchain::gcc};
+};
+
+//<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):([0-9]+):[0-9]+:[[:blank:]]+([Rr]equired from.*)]]>
+struct RequiredFromWarning : LocationRule<LocationForm::fileLineColumn, LocationSeparator::blanks, MessageStartsWith<"[Rr]equired from">>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::requiredFromWarning,
+                                               .name = "'Required from' warning",
+                                               .type = CompilerOutputLineType::warning,
+                                               .fileNameIdx = 1,
+                                               .lineIdx = 2,
+                                               .messageIdx = 3,
+                                               .toolchain = CompilerOutputToolchain::gcc};
+};
+
+//<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):([0-9]+):[0-9]+:[[:blank:]]+([Ii]nstantiated from .*)]]>
+struct InstantiatedFromInfo2 : LocationRule<LocationForm::fileLineColumn, LocationSeparator::blanks, MessageStartsWith<"[Ii]nstantiated from ">>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::instantiatedFromInfo2,
+                                               .name = "'Instantiated from' info (2)",
+                                               .type = CompilerOutputLineType::info,
+                                               .fileNameIdx = 1,
+                                               .lineIdx = 2,
+                                               .messageIdx = 3,
+                                               .toolchain = CompilerOutputToolchain::gcc};
+};
+
+//<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):([0-9]+):[[:blank:]]+([Ii]nstantiated from .*)]]>
+struct InstantiatedFromInfo : LocationRule<LocationForm::fileLine, LocationSeparator::blanks, MessageStartsWith<"[Ii]nstantiated from ">>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::instantiatedFromInfo,
+                                               .name = "'Instantiated from' info",
+                                               .type = CompilerOutputLineType::info,
+                                               .fileNameIdx = 1,
+                                               .lineIdx = 2,
+                                               .messageIdx = 3,
+                                               .toolchain = CompilerOutputToolchain::gcc};
+};
+
+//<![CDATA[windres.exe:[[:blank:]]([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):([0-9]+):[[:blank:]](.*)]]>
+struct ResourceCompilerError : WindresLocationRule<LocationForm::fileLine, LocationSeparator::blank, AnyMessage>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::resourceCompilerError,
+                                               .name = "Resource compiler error",
+                                               .type = CompilerOutputLineType::error,
+                                               .fileNameIdx = 1,
+                                               .lineIdx = 2,
+                                               .messageIdx = 3,
+                                               .toolchain = CompilerOutputToolchain::mingw};
+};
+
+//<![CDATA[windres.exe:[[:blank:]](.*)]]>
+struct ResourceCompilerError2 : RegexRule<"windres.exe:[[:blank:]](.*)", anchorWindres>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::resourceCompilerError2,
+                                               .name = "Resource compiler error (2)",
+                                               .type = CompilerOutputLineType::error,
+                                               .fileNameIdx = 0,
+                                               .lineIdx = 0,
+                                               .messageIdx = 1,
+                                               .toolchain = CompilerOutputToolchain::mingw};
+};
+
+//<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):([0-9]+):([0-9]+):[[:blank:]]([Ww]arning:[[:blank:]].*)]]>
+struct PreprocessorWarning : LocationRule<LocationForm::fileLineColumn, LocationSeparator::blank, MessageStartsWith<"[Ww]arning:[[:blank:]]">>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::preprocessorWarning,
+                                               .name = "Preprocessor warning",
+                                               .type = CompilerOutputLineType::warning,
+                                               .fileNameIdx = 1,
+                                               .lineIdx = 2,
+                                               .messageIdx = 4,
+                                               .toolchain = CompilerOutputToolchain::gcc};
+};
+
+//<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):([0-9]+):[0-9]+:[[:blank:]]([Nn]ote:[[:blank:]].*)]]>
+struct CompilerNote2 : LocationRule<LocationForm::fileLineColumn, LocationSeparator::blank, MessageStartsWith<"[Nn]ote:[[:blank:]]">>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::compilerNote2,
+                                               .name = "Compiler note (2)",
+                                               .type = CompilerOutputLineType::info,
+                                               .fileNameIdx = 1,
+                                               .lineIdx = 2,
+                                               .messageIdx = 3,
+                                               .toolchain = CompilerOutputToolchain::gcc};
+};
+
+//<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):([0-9]+):[[:blank:]]([Nn]ote:[[:blank:]].*)]]>
+struct CompilerNote : LocationRule<LocationForm::fileLine, LocationSeparator::blank, MessageStartsWith<"[Nn]ote:[[:blank:]]">>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::compilerNote,
+                                               .name = "Compiler note",
+                                               .type = CompilerOutputLineType::info,
+                                               .fileNameIdx = 1,
+                                               .lineIdx = 2,
+                                               .messageIdx = 3,
+                                               .toolchain = CompilerOutputToolchain::gcc};
+};
+
+//<![CDATA[([Nn]ote:[[:blank:]].*)]]>
+struct GeneralNote : AnchorRule<anchorNote, FindNoteMessage>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::generalNote,
+                                               .name = "General note",
+                                               .type = CompilerOutputLineType::info,
+                                               .fileNameIdx = 0,
+                                               .lineIdx = 0,
+                                               .messageIdx = 1,
+                                               .toolchain = CompilerOutputToolchain::gcc};
+};
+
+//<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):([0-9]+):[0-9]+:[[:blank:]](.*)]]>
+// Also covers 'Compiler warning (2)', 'Compiler error (2)' and 'Linker error', which used the same pattern further down and
+// could never match.
+struct PreprocessorError : LocationRule<LocationForm::fileLineColumn, LocationSeparator::blank, AnyMessage>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::preprocessorError,
+                                               .name = "Preprocessor error",
+                                               .type = CompilerOutputLineType::error,
+                                               .fileNameIdx = 1,
+                                               .lineIdx = 2,
+                                               .messageIdx = 3,
+                                               .toolchain = CompilerOutputToolchain::gcc};
+};
+
+//<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):([0-9]+):[[:blank:]]([Ww]arning:[[:blank:]].*)]]>
+struct CompilerWarning : LocationRule<LocationForm::fileLine, LocationSeparator::blank, MessageStartsWith<"[Ww]arning:[[:blank:]]">>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::compilerWarning,
+                                               .name = "Compiler warning",
+                                               .type = CompilerOutputLineType::warning,
+                                               .fileNameIdx = 1,
+                                               .lineIdx = 2,
+                                               .messageIdx = 3,
+                                               .toolchain = CompilerOutputToolchain::gcc};
+};
+
+//<![CDATA[[][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+\.o:([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):([0-9]+):[[:blank:]](undefined
+// reference.*)]]>
+struct UndefinedReference2 : ObjectLocationRule<LocationForm::fileLine, LocationSeparator::blank, MessageStartsWith<"undefined reference">>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::undefinedReference2,
+                                               .name = "Undefined reference (2)",
+                                               .type = CompilerOutputLineType::error,
+                                               .fileNameIdx = 1,
+                                               .lineIdx = 2,
+                                               .messageIdx = 3,
+                                               .toolchain = CompilerOutputToolchain::binutils};
+};
+
+//<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):([0-9]+):[[:blank:]](.*)]]>
+struct CompilerError : LocationRule<LocationForm::fileLine, LocationSeparator::blank, AnyMessage>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::compilerError,
+                                               .name = "Compiler error",
+                                               .type = CompilerOutputLineType::error,
+                                               .fileNameIdx = 1,
+                                               .lineIdx = 2,
+                                               .messageIdx = 3,
+                                               .toolchain = CompilerOutputToolchain::gcc};
+};
+
+//<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):\(\.text\+[0-9a-fA-FxX]+\):[[:blank:]]([Ww]arning:[[:blank:]].*)]]>
+struct LinkerWarning : LocationRule<LocationForm::textOffset, LocationSeparator::blank, MessageStartsWith<"[Ww]arning:[[:blank:]]">>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::linkerWarning,
+                                               .name = "Linker warning",
+                                               .type = CompilerOutputLineType::warning,
+                                               .fileNameIdx = 1,
+                                               .lineIdx = 0,
+                                               .messageIdx = 2,
+                                               .toolchain = CompilerOutputToolchain::binutils};
+};
+
+//<![CDATA[[][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+\(.text\+[0-9A-Za-z]+\):([[:blank:]A-Za-z0-9_:+/\.-]+):[[:blank:]](.*)]]>
+struct LinkerError2 : AnchorRule<anchorTextOffset, FindLinkerError2Message>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::linkerError2,
+                                               .name = "Linker error (2)",
+                                               .type = CompilerOutputLineType::error,
+                                               .fileNameIdx = 1,
+                                               .lineIdx = 0,
+                                               .messageIdx = 2,
+                                               .toolchain = CompilerOutputToolchain::binutils};
+};
+
+//<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):\(\.text\+[0-9a-fA-FxX]+\):(.*)]]>
+struct LinkerError3 : LocationRule<LocationForm::textOffset, LocationSeparator::none, AnyMessage>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::linkerError3,
+                                               .name = "Linker error (3)",
+                                               .type = CompilerOutputLineType::error,
+                                               .fileNameIdx = 1,
+                                               .lineIdx = 0,
+                                               .messageIdx = 2,
+                                               .toolchain = CompilerOutputToolchain::binutils};
+};
+
+//<![CDATA[.*(ld.*):[[:blank:]](cannot find.*)]]>
+struct LinkerErrorLibNotFound : AnchorRule<anchorCannotFind, FindCannotFindMessage>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::linkerErrorLibNotFound,
+                                               .name = "Linker error (lib not found)",
+                                               .type = CompilerOutputLineType::error,
+                                               .fileNameIdx = 1,
+                                               .lineIdx = 0,
+                                               .messageIdx = 2,
+                                               .toolchain = CompilerOutputToolchain::binutils};
+};
+
+//<![CDATA[.*(ld.*):[[:blank:]](cannot open output file.*):[[:blank:]](.*)]]>
+// TODO msg2
+struct LinkerErrorCannotOpenOutputFile : AnchorRule<anchorCannotOpenOutputFile, FindCannotOpenOutputFileMessage>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::linkerErrorCannotOpenOutputFile,
+                                               .name = "Linker error (cannot open output file)",
+                                               .type = CompilerOutputLineType::error,
+                                               .fileNameIdx = 1,
+                                               .lineIdx = 0,
+                                               .messageIdx = 2,
+                                               .toolchain = CompilerOutputToolchain::binutils};
+};
+
+//<![CDATA[.*(ld.*):[[:blank:]](unrecognized option.*)]]>
+struct LinkerErrorUnrecognizedOption : AnchorRule<anchorUnrecognized, FindLinkerUnrecognizedOptionMessage>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::linkerErrorUnrecognizedOption,
+                                               .name = "Linker error (unrecognized option)",
+                                               .type = CompilerOutputLineType::error,
+                                               .fileNameIdx = 1,
+                                               .lineIdx = 0,
+                                               .messageIdx = 2,
+                                               .toolchain = CompilerOutputToolchain::binutils};
+};
+
+//<![CDATA[.*cc.*:[[:blank:]]([Uu]nrecognized.*option.*)]]>
+struct CompilerErrorUnrecognizedOption : AnchorRule<anchorUnrecognized, FindCompilerUnrecognizedOptionMessage>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::compilerErrorUnrecognizedOption,
+                                               .name = "Compiler error (unrecognized option)",
+                                               .type = CompilerOutputLineType::error,
+                                               .fileNameIdx = 0,
+                                               .lineIdx = 0,
+                                               .messageIdx = 1,
+                                               .toolchain = CompilerOutputToolchain::gcc};
+};
+
+//<![CDATA[.*:(.*):[[:blank:]](No such file or directory.*)]]>
+struct NoSuchFileOrDirectory : AnchorRule<anchorNoSuchFile, FindNoSuchFileMessage>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::noSuchFileOrDirectory,
+                                               .name = "No such file or directory",
+                                               .type = CompilerOutputLineType::error,
+                                               .fileNameIdx = 1,
+                                               .lineIdx = 0,
+                                               .messageIdx = 2,
+                                               .toolchain = CompilerOutputToolchain::gcc};
+};
+
+//<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):[[:blank:]](undefined reference.*)]]>
+struct UndefinedReference : LocationRule<LocationForm::file, LocationSeparator::blank, MessageStartsWith<"undefined reference">>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::undefinedReference,
+                                               .name = "Undefined reference",
+                                               .type = CompilerOutputLineType::error,
+                                               .fileNameIdx = 1,
+                                               .lineIdx = 0,
+                                               .messageIdx = 2,
+                                               .toolchain = CompilerOutputToolchain::binutils};
+};
+
+//<![CDATA[([Ee]rror:[[:blank:]].*)]]>
+struct GeneralError : AnchorRule<anchorError, FindErrorMessage>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::generalError,
+                                               .name = "General error",
+                                               .type = CompilerOutputLineType::error,
+                                               .fileNameIdx = 0,
+                                               .lineIdx = 0,
+                                               .messageIdx = 1,
+                                               .toolchain = CompilerOutputToolchain::gcc};
+};
+
+//<![CDATA[([Ww]arning:[[:blank:]].*)]]>
+struct GeneralWarning : AnchorRule<anchorWarning, FindWarningMessage>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::generalWarning,
+                                               .name = "General warning",
+                                               .type = CompilerOutputLineType::warning,
+                                               .fileNameIdx = 0,
+                                               .lineIdx = 0,
+                                               .messageIdx = 1,
+                                               .toolchain = CompilerOutputToolchain::gcc};
+};
+
+//<![CDATA[([Ii]nfo:[[:blank:]].*)\(auto-import\)]]>
+struct AutoImportInfo : AnchorRule<anchorInfo, FindAutoImportMessage>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::autoImportInfo,
+                                               .name = "Auto-import info",
+                                               .type = CompilerOutputLineType::info,
+                                               .fileNameIdx = 0,
+                                               .lineIdx = 0,
+                                               .messageIdx = 1,
+                                               .toolchain = CompilerOutputToolchain::mingw};
+};
+
+//<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):[[:blank:]]+(duplicate section.*has different size)]]>
+struct LinkerWarningDifferentSizedSections
+    : LocationRule<LocationForm::file, LocationSeparator::blanks, MessageStartsAndEndsWith<"duplicate section", "has different size">>
+{
+    static constexpr CompilerRegexInfo info = {.rule = CompilerOutputRule::linkerWarningDifferentSizedSections,
+                                               .name = "Linker warning (different sized sections)",
+                                               .type = CompilerOutputLineType::warning,
+                                               .fileNameIdx = 1,
+                                               .lineIdx = 0,
+                                               .messageIdx = 2,
+                                               .toolchain = CompilerOutputToolchain::binutils};
+};
+}  // namespace compiler_output_rules
+
+// An ordered list of rules, the first one that matches a line wins
+template <typename... Rules>
+struct CompilerOutputRuleSet
+{
+};
+
+using DefaultCompilerOutputRuleSet = CompilerOutputRuleSet<
+    compiler_output_rules::FatalError, compiler_output_rules::InFunctionInfo, compiler_output_rules::SkippingInstantiationContextsInfo2,
+    compiler_output_rules::SkippingInstantiationContextsInfo, compiler_output_rules::InInstantiationWarning,
+    compiler_output_rules::RequiredFromWarning, compiler_output_rules::InstantiatedFromInfo2, compiler_output_rules::InstantiatedFromInfo,
+    compiler_output_rules::ResourceCompilerError, compiler_output_rules::ResourceCompilerError2, compiler_output_rules::PreprocessorWarning,
+    compiler_output_rules::CompilerNote2, compiler_output_rules::CompilerNote, compiler_output_rules::GeneralNote,
+    compiler_output_rules::PreprocessorError, compiler_output_rules::CompilerWarning, compiler_output_rules::UndefinedReference2,
+    compiler_output_rules::CompilerError, compiler_output_rules::LinkerWarning, compiler_output_rules::LinkerError2,
+    compiler_output_rules::LinkerError3, compiler_output_rules::LinkerErrorLibNotFound, compiler_output_rules::LinkerErrorCannotOpenOutputFile,
+    compiler_output_rules::LinkerErrorUnrecognizedOption, compiler_output_rules::CompilerErrorUnrecognizedOption,
+    compiler_output_rules::NoSuchFileOrDirectory, compiler_output_rules::UndefinedReference, compiler_output_rules::GeneralError,
+    compiler_output_rules::GeneralWarning, compiler_output_rules::AutoImportInfo, compiler_output_rules::LinkerWarningDifferentSizedSections>;
+
+/*
+ * Counters of one rule. For CompilerOutputRule::none, hits are the lines no rule matched, rejections the lines that got
+ * past the anchors to the rules, and the time is the time spent finding the anchors and the location prefix.
+ */
+struct CompilerOutputRuleStats
+{
+    uint64_t hits{0};
+    uint64_t rejections{0};
+    uint64_t nanoseconds{0};
+};
+
+using CompilerOutputStatsTable = std::array<CompilerOutputRuleStats, compilerOutputRuleCount>;
+
+// Default instrumentation of CompilerOutputParser, compiled out
+struct NoCompilerOutputStats
+{
+    static constexpr bool enabled = false;
+};
+
+/*
+ * Instrumentation counting, for every rule, the lines it matched, the lines it was tried on and rejected, and the time
+ * spent trying it. Each thread counts into its own table, Collect() adds up the tables of all the threads, the ones
+ * that have exited included.
+ */
+class CompilerOutputStats
+{
+public:
+    static constexpr bool enabled = true;
+
+    static void Record(CompilerOutputRule rule, bool matched, uint64_t nanoseconds)
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "Linker error (2)", .type = CompilerOutputLineType::error, .fileNameIdx = 1, .lineIdx = 0, .messageIdx = 2};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        ThreadCounters::Get().Add(static_cast<size_t>(rule), matched, nanoseconds);
     }
-    //<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):\(\.text\+[0-9a-fA-FxX]+\):(.*)]]>
-    else if (auto m = ctre::match<"([{}()[:blank:]#%$~[:alnum:]!&_:+/\\\\\\.\\-]{1,512}):\\(\\.text\\+[0-9a-fA-FxX]+\\):(.*)">(line))
+
+    static CompilerOutputStatsTable Collect()
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "Linker error (3)", .type = CompilerOutputLineType::error, .fileNameIdx = 1, .lineIdx = 0, .messageIdx = 2};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        CompilerOutputStatsTable table = registry.retired;
+        for (const ThreadCounters* counters : registry.threads) counters->AddTo(table);
+        return table;
     }
-    //<![CDATA[.*(ld.*):[[:blank:]](cannot find.*)]]>
-    else if (auto m = ctre::match<".{0,1023}(ld.{0,1023}):[[:blank:]](cannot find.*)">(line))  // Error
+
+    // Only meaningful while no other thread is parsing
+    static void Reset()
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "Linker error (lib not found)", .type = CompilerOutputLineType::error, .fileNameIdx = 1, .lineIdx = 0, .messageIdx = 2};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.retired = {};
+        for (ThreadCounters* counters : registry.threads) counters->Clear();
     }
-    //<![CDATA[.*(ld.*):[[:blank:]](cannot open output file.*):[[:blank:]](.*)]]>
-    else if (auto m = ctre::match<".{0,1023}(ld.{0,1023}):[[:blank:]](cannot open output file.*):[[:blank:]](.*)">(line))
+
+private:
+    class ThreadCounters;
+
+    struct Registry
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "Linker error (cannot open output file)", .type = CompilerOutputLineType::error, .fileNameIdx = 1, .lineIdx = 0, .messageIdx = 2};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
-        // TODO msg2
-    }
-    //<![CDATA[.*(ld.*):[[:blank:]](unrecognized option.*)]]>
-    else if (auto m = ctre::match<".{0,1023}(ld.{0,1023}):[[:blank:]](unrecognized option.*)">(line))
+        std::mutex mutex;
+        std::vector<ThreadCounters*> threads;
+        CompilerOutputStatsTable retired;
+    };
+
+    static Registry& GetRegistry()
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "Linker error (unrecognized option)", .type = CompilerOutputLineType::error, .fileNameIdx = 1, .lineIdx = 0, .messageIdx = 2};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        static Registry registry;
+        return registry;
     }
-    //<![CDATA[.*cc.*:[[:blank:]]([Uu]nrecognized.*option.*)]]>
-    else if (auto m = ctre::match<".{0,1023}cc.{0,1023}:[[:blank:]]([Uu]nrecognized.*option.*)">(line))
+
+    // Written by its thread only, relaxed atomics let Collect() read it while the thread is parsing
+    class ThreadCounters
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "Compiler error (unrecognized option)", .type = CompilerOutputLineType::error, .fileNameIdx = 0, .lineIdx = 0, .messageIdx = 1};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
-    }
-    //<![CDATA[.*:(.*):[[:blank:]](No such file or directory.*)]]>
-    else if (auto m = ctre::match<".{0,1023}:(.{0,1023}):[[:blank:]](No such file or directory.*)">(line))
+    public:
+        static ThreadCounters& Get()
+        {
+            thread_local ThreadCounters counters;
+            return counters;
+        }
+
+        ThreadCounters()
+        {
+            Registry& registry = GetRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.threads.push_back(this);
+        }
+
+        ~ThreadCounters()
+        {
+            Registry& registry = GetRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            AddTo(registry.retired);
+            std::erase(registry.threads, this);
+        }
+
+        void Add(size_t rule, bool matched, uint64_t nanoseconds)
+        {
+            Increment(matched ? m_hits[rule] : m_rejections[rule], 1);
+            Increment(m_nanoseconds[rule], nanoseconds);
+        }
+
+        void AddTo(CompilerOutputStatsTable& table) const
+        {
+            for (size_t rule = 0; rule < compilerOutputRuleCount; ++rule)
+            {
+                table[rule].hits += m_hits[rule].load(std::memory_order_relaxed);
+                table[rule].rejections += m_rejections[rule].load(std::memory_order_relaxed);
+                table[rule].nanoseconds += m_nanoseconds[rule].load(std::memory_order_relaxed);
+            }
+        }
+
+        void Clear()
+        {
+            for (size_t rule = 0; rule < compilerOutputRuleCount; ++rule)
+            {
+                m_hits[rule].store(0, std::memory_order_relaxed);
+                m_rejections[rule].store(0, std::memory_order_relaxed);
+                m_nanoseconds[rule].store(0, std::memory_order_relaxed);
+            }
+        }
+
+    private:
+        // Single writer, no need for a locked add
+        static void Increment(std::atomic<uint64_t>& counter, uint64_t value)
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        }
+
+        std::array<std::atomic<uint64_t>, compilerOutputRuleCount> m_hits{};
+        std::array<std::atomic<uint64_t>, compilerOutputRuleCount> m_rejections{};
+        std::array<std::atomic<uint64_t>, compilerOutputRuleCount> m_nanoseconds{};
+    };
+};
+
+/*
+ * Parser specialized at compile time to a rule set, restricted to the rules of the given toolchains. Rules of other
+ * toolchains are not instantiated, e.g. CompilerOutputParser<CompilerOutputToolchain::gcc | CompilerOutputToolchain::binutils>
+ * leaves out the windres.exe and auto-import rules of MinGW. Stats is NoCompilerOutputStats or CompilerOutputStats.
+ */
+template <CompilerOutputToolchain Toolchains = CompilerOutputToolchain::all, typename RuleSet = DefaultCompilerOutputRuleSet,
+          typename Stats = NoCompilerOutputStats>
+class CompilerOutputParser;
+
+template <CompilerOutputToolchain Toolchains, typename... Rules, typename Stats>
+class CompilerOutputParser<Toolchains, CompilerOutputRuleSet<Rules...>, Stats>
+{
+public:
+    static CompilerOutputLineView Parse(std::string_view line)
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "No such file or directory", .type = CompilerOutputLineType::error, .fileNameIdx = 1, .lineIdx = 0, .messageIdx = 2};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        using namespace compiler_output_parser_detail;
+        CompilerOutputLineView view;
+        const auto start = Now();
+        const uint32_t anchors = FindAnchors(line);
+        if (!anchors)
+        {
+            Record(CompilerOutputRule::none, true, start);
+            return view;
+        }
+        const LineContext context{line, anchors, LocationPrefix((anchors & anchorLocation) ? line : std::string_view())};
+        Record(CompilerOutputRule::none, false, start);
+        if (!(Apply<Rules>(context, view) || ...)) Record(CompilerOutputRule::none, true, Now());
+        return view;
     }
-    //<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):[[:blank:]](undefined reference.*)]]>
-    else if (auto m = ctre::match<"([{}()[:blank:]#%$~[:alnum:]!&_:+/\\\\\\.\\-]{1,512}):[[:blank:]](undefined reference.*)">(line))
+
+    /*
+     * Parse(line) with the diagnostics filter does not select returned as normal lines. Only the rules that can give a
+     * selected diagnostic are tried, then, once one of them matched, the other rules before it, since one of those would
+     * have won the line. With a file prefix, the rules whose file name starts the line are left out of lines that do
+     * not start with it, before any message is looked at.
+     */
+    static CompilerOutputLineView Parse(std::string_view line, const CompilerOutputFilter& filter)
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "Undefined reference", .type = CompilerOutputLineType::error, .fileNameIdx = 1, .lineIdx = 0, .messageIdx = 2};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        using namespace compiler_output_parser_detail;
+        if (filter.IsEmpty()) return Parse(line);
+        const auto start = Now();
+        const uint32_t anchors = FindAnchors(line);
+        if (!anchors)
+        {
+            Record(CompilerOutputRule::none, true, start);
+            return {};
+        }
+        const LineContext context{line, anchors, LocationPrefix((anchors & anchorLocation) ? line : std::string_view())};
+        Record(CompilerOutputRule::none, false, start);
+        return ParseSelectable(context, filter, line.starts_with(filter.filePrefix), std::index_sequence_for<Rules...>());
     }
-    //<![CDATA[([Ee]rror:[[:blank:]].*)]]>
-    else if (auto m = ctre::match<".{0,1023}([Ee]rror:[[:blank:]].*)">(line))
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static Clock::time_point Now()
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "General error", .type = CompilerOutputLineType::error, .fileNameIdx = 0, .lineIdx = 0, .messageIdx = 1};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        if constexpr (Stats::enabled) return Clock::now();
+        else return {};
     }
-    //<![CDATA[([Ww]arning:[[:blank:]].*)]]>
-    else if (auto m = ctre::match<".{0,1023}([Ww]arning:[[:blank:]].*)">(line))
+
+    static void Record(CompilerOutputRule rule, bool matched, Clock::time_point start)
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "General warning", .type = CompilerOutputLineType::warning, .fileNameIdx = 0, .lineIdx = 0, .messageIdx = 1};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        if constexpr (Stats::enabled)
+        {
+            Stats::Record(rule, matched, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Now() - start).count()));
+        }
     }
-    //<![CDATA[([Ii]nfo:[[:blank:]].*)\(auto-import\)]]>
-    else if (auto m = ctre::match<"(.{0,1023}[Ii]nfo:[[:blank:]].*)\\(auto-import\\)">(line))
+
+    // Whether Rule can give a diagnostic that filter selects
+    template <typename Rule>
+    static bool Selectable(const CompilerOutputFilter& filter, bool lineHasFilePrefix)
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {
-            .name = "Auto-import info", .type = CompilerOutputLineType::info, .fileNameIdx = 0, .lineIdx = 0, .messageIdx = 1};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        if (!filter.SelectsType(Rule::info.type)) return false;
+        return filter.filePrefix.empty() || (Rule::info.fileNameIdx && (lineHasFilePrefix || !Rule::fileNameStartsLine));
     }
-    //<![CDATA[([][{}()[:blank:]#%$~[:alnum:]!&_:+/\\\.-]+):[[:blank:]]+(duplicate section.*has different size)]]>
-    else if (auto m = ctre::match<"([{}()[:blank:]#%$~[:alnum:]!&_:+/\\\\\\.\\-]{1,512}):[[:blank:]]+(duplicate section.*has different size)">(line))
+
+    template <size_t... Indexes>
+    static CompilerOutputLineView ParseSelectable(const compiler_output_parser_detail::LineContext& context, const CompilerOutputFilter& filter,
+                                                  bool lineHasFilePrefix, std::index_sequence<Indexes...>)
     {
-        static constexpr CompilerRegexInfo compilerRegexInfo = {.name = "Linker warning (different sized sections)",
-                                                                .type = CompilerOutputLineType::warning,
-                                                                .fileNameIdx = 1,
-                                                                .lineIdx = 0,
-                                                                .messageIdx = 2};
-        POPULATE_INFO(ret, m, compilerRegexInfo);
+        CompilerOutputLineView view;
+        size_t winner = sizeof...(Rules);
+        ((Selectable<Rules>(filter, lineHasFilePrefix) && Apply<Rules>(context, view) && (winner = Indexes, true)) || ...);
+        if (winner == sizeof...(Rules))
+        {
+            Record(CompilerOutputRule::none, true, Now());
+            return {};
+        }
+        CompilerOutputLineView earlier;
+        if (((Indexes < winner && !Selectable<Rules>(filter, lineHasFilePrefix) && Apply<Rules>(context, earlier)) || ...)) return {};
+        return filter.Selects(view) ? view : CompilerOutputLineView();
     }
-    else
+
+    template <typename Rule>
+    static bool Apply(const compiler_output_parser_detail::LineContext& context, CompilerOutputLineView& view)
     {
-        ret.type = CompilerOutputLineType::normal;
-        /*std::cout << "Match failed!\n";*/
+        if constexpr ((Rule::info.toolchain & Toolchains) != CompilerOutputToolchain::none)
+        {
+            const auto start = Now();
+            const bool matched = Rule::template Apply<Rule::info>(context, view);
+            Record(Rule::info.rule, matched, start);
+            if (!matched) return false;
+            view.type = Rule::info.type;
+            view.rule = Rule::info.rule;
+            return true;
+        }
+        else
+        {
+            return false;
+        }
     }
-    return ret;
+};
+
+namespace compiler_output_parser_detail
+{
+template <typename... Rules>
+constexpr const char* RuleName(CompilerOutputRule rule, CompilerOutputRuleSet<Rules...>)
+{
+    const char* name = "None";
+    ((Rules::info.rule == rule && (name = Rules::info.name)) || ...);
+    return name;
+}
+}  // namespace compiler_output_parser_detail
+
+// compiler_output_parser_lib.cpp defines these out of line for the compiled library
+#ifndef COMPILER_OUTPUT_PARSER_LIB_BUILD
+inline CompilerOutputLineView GetCompilerOutputLineView(std::string_view line) { return CompilerOutputParser<>::Parse(line); }
+
+// Diagnostics filter does not select are returned as normal lines
+inline CompilerOutputLineView GetCompilerOutputLineView(std::string_view line, const CompilerOutputFilter& filter)
+{
+    return CompilerOutputParser<>::Parse(line, filter);
+}
+
+// The name of the rule in DefaultCompilerOutputRuleSet, "None" for CompilerOutputRule::none
+constexpr const char* GetCompilerOutputRuleName(CompilerOutputRule rule)
+{
+    return compiler_output_parser_detail::RuleName(rule, DefaultCompilerOutputRuleSet());
+}
+
+inline CompilerOutputLineInfo GetCompilerOutputLineInfo(std::string_view line) { return MakeCompilerOutputLineInfo(GetCompilerOutputLineView(line)); }
+
+// The strings of the result are allocated from resource
+inline CompilerOutputPmrLineInfo GetCompilerOutputLineInfo(std::string_view line, std::pmr::memory_resource* resource)
+{
+    return MakeCompilerOutputLineInfo(GetCompilerOutputLineView(line), resource);
+}
+#endif
+
+// All diagnostics of buffer, normal lines are left out
+template <typename Parser = CompilerOutputParser<>>
+CompilerOutputBatch ParseCompilerOutput(std::string_view buffer)
+{
+    CompilerOutputBatch batch;
+    ForEachCompilerOutputLine(buffer,
+                              [&batch, buffer](std::string_view line)
+                              {
+                                  const CompilerOutputLineView view = Parser::Parse(line);
+                                  if (view.type != CompilerOutputLineType::normal) batch.Append(view, buffer);
+                              });
+    return batch;
 }
 
 #endif  // COMPILER_OUTPUT_PARSER_HPP_INCLUDED
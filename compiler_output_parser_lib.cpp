@@ -0,0 +1,42 @@
+/*
+ * Compiler Output Parser: Parse error, warning and messages
+ * Copyright (C) 2024  Christo Joseph
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define COMPILER_OUTPUT_PARSER_LIB_BUILD
+#include "compiler_output_parser.hpp"
+#include "compiler_output_parser_lib.hpp"
+
+CompilerOutputLineView GetCompilerOutputLineView(std::string_view line) { return CompilerOutputParser<>::Parse(line); }
+
+CompilerOutputLineView GetCompilerOutputLineView(std::string_view line, const CompilerOutputFilter& filter)
+{
+    return CompilerOutputParser<>::Parse(line, filter);
+}
+
+CompilerOutputLineInfo GetCompilerOutputLineInfo(std::string_view line) { return MakeCompilerOutputLineInfo(GetCompilerOutputLineView(line)); }
+
+CompilerOutputPmrLineInfo GetCompilerOutputLineInfo(std::string_view line, std::pmr::memory_resource* resource)
+{
+    return MakeCompilerOutputLineInfo(GetCompilerOutputLineView(line), resource);
+}
+
+const char* GetCompilerOutputRuleName(CompilerOutputRule rule)
+{
+    return compiler_output_parser_detail::RuleName(rule, DefaultCompilerOutputRuleSet());
+}
+
+CompilerOutputBatch ParseCompilerOutput(std::string_view buffer) { return ParseCompilerOutput<>(buffer); }
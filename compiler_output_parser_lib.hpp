@@ -0,0 +1,48 @@
+/*
+ * Compiler Output Parser: Parse error, warning and messages
+ * Copyright (C) 2024  Christo Joseph
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMPILER_OUTPUT_PARSER_LIB_HPP_INCLUDED
+#define COMPILER_OUTPUT_PARSER_LIB_HPP_INCLUDED
+
+#if defined(COMPILER_OUTPUT_PARSER_HPP_INCLUDED) && !defined(COMPILER_OUTPUT_PARSER_LIB_BUILD)
+#error "compiler_output_parser_lib.hpp is the compiled library, it cannot be used along with the header only compiler_output_parser.hpp"
+#endif
+
+#include <string_view>
+#include "compiler_output_types.hpp"
+
+/*
+ * The parser with DefaultCompilerOutputRuleSet, compiled once in the compiler-output-parser library so that including
+ * this header costs no regex instantiation. Selecting the rules, the toolchains or the statistics policy needs the
+ * templates of the header only compiler_output_parser.hpp; a program uses one or the other.
+ */
+
+CompilerOutputLineView GetCompilerOutputLineView(std::string_view line);
+// Diagnostics filter does not select are returned as normal lines
+CompilerOutputLineView GetCompilerOutputLineView(std::string_view line, const CompilerOutputFilter& filter);
+CompilerOutputLineInfo GetCompilerOutputLineInfo(std::string_view line);
+// The strings of the result are allocated from resource
+CompilerOutputPmrLineInfo GetCompilerOutputLineInfo(std::string_view line, std::pmr::memory_resource* resource);
+
+// The name of the rule in DefaultCompilerOutputRuleSet, "None" for CompilerOutputRule::none
+const char* GetCompilerOutputRuleName(CompilerOutputRule rule);
+
+// All diagnostics of buffer, normal lines are left out
+CompilerOutputBatch ParseCompilerOutput(std::string_view buffer);
+
+#endif  // COMPILER_OUTPUT_PARSER_LIB_HPP_INCLUDED
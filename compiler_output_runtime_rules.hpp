@@ -0,0 +1,1191 @@
+/*
+ * Compiler Output Parser: Parse error, warning and messages
+ * Copyright (C) 2024  Christo Joseph
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMPILER_OUTPUT_RUNTIME_RULES_HPP_INCLUDED
+#define COMPILER_OUTPUT_RUNTIME_RULES_HPP_INCLUDED
+
+/*
+ * Rules loaded at run time from a Code::Blocks compiler XML instead of compiled in, for toolchains the built-in rules do
+ * not cover. All the patterns are compiled into one DFA, built as lines need it, whose states know the first rule
+ * matching the line, so a line is classified in one pass whatever the number of rules. Only the line of the rule that won
+ * is then matched again for its capture groups: by a backtracker that never tries an instruction at a position twice when
+ * the program of the rule times the length of the line is small, which covers usual lines, and by a Pike VM otherwise.
+ * Does not depend on ctre, it goes with either header of the parser.
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "compiler_output_types.hpp"
+
+namespace compiler_output_runtime_detail
+{
+using ByteSet = std::bitset<256>;
+
+// A parsed pattern
+struct Node
+{
+    enum class Kind : uint8_t
+    {
+        empty,
+        bytes,
+        concatenation,
+        alternation,
+        repeat,
+        group
+    };
+
+    static constexpr uint32_t unbounded = UINT32_MAX;
+
+    Kind kind{Kind::empty};
+    ByteSet bytes;
+    std::vector<Node> children;
+    uint32_t min{0};
+    uint32_t max{0};
+    bool greedy{true};
+    uint32_t group{0};
+};
+
+/*
+ * POSIX extended regular expressions as the Code::Blocks patterns use them: alternation, groups, (?:...), the * + ? {m,n}
+ * quantifiers and their lazy forms, bracket expressions with [:class:] names, \d \s \w and their negations, and escaped
+ * characters. Like Code::Blocks, a pattern is searched for in the line: the match starts as early as it can unless ^
+ * anchors it to the start of the line, and goes on to any end unless $ anchors it to the end. ^ and $ are only
+ * allowed there.
+ */
+class PatternParser
+{
+public:
+    explicit PatternParser(std::string_view pattern) : m_pattern(pattern) {}
+
+    // root matches whole lines
+    bool Parse(Node& root, uint32_t& groupCount, std::string& error)
+    {
+        const bool anchoredStart = m_pattern.starts_with('^');
+        if (anchoredStart) m_pos = 1;
+        const bool anchoredEnd = m_pattern.size() > m_pos && m_pattern.ends_with('$') && !m_pattern.ends_with("\\$");
+        if (anchoredEnd) m_pattern.remove_suffix(1);
+        Node pattern;
+        const bool ok = ParseAlternation(pattern, 0) && (m_pos == m_pattern.size() || Fail("unmatched )"));
+        groupCount = m_groupCount;
+        if (!ok)
+        {
+            error = m_error;
+            return false;
+        }
+        root = Node();
+        root.kind = Node::Kind::concatenation;
+        if (!anchoredStart) root.children.push_back(AnyBytes(false));
+        root.children.push_back(std::move(pattern));
+        if (!anchoredEnd) root.children.push_back(AnyBytes(true));
+        return true;
+    }
+
+private:
+    static constexpr unsigned maxDepth = 256;
+    static constexpr uint32_t maxRepeat = 1000;
+
+    // .* or .*?
+    static Node AnyBytes(bool greedy)
+    {
+        Node any;
+        any.kind = Node::Kind::bytes;
+        any.bytes.set();
+        Node repeat;
+        repeat.kind = Node::Kind::repeat;
+        repeat.max = Node::unbounded;
+        repeat.greedy = greedy;
+        repeat.children.push_back(std::move(any));
+        return repeat;
+    }
+
+    bool Fail(const char* message)
+    {
+        m_error = std::string(message) + " at offset " + std::to_string(m_pos);
+        return false;
+    }
+
+    bool AtEnd() const { return m_pos == m_pattern.size(); }
+    char Peek() const { return m_pattern[m_pos]; }
+
+    bool ParseAlternation(Node& node, unsigned depth)
+    {
+        if (depth > maxDepth) return Fail("pattern nested too deeply");
+        Node branch;
+        if (!ParseConcatenation(branch, depth)) return false;
+        if (AtEnd() || Peek() != '|')
+        {
+            node = std::move(branch);
+            return true;
+        }
+        node.kind = Node::Kind::alternation;
+        node.children.push_back(std::move(branch));
+        while (!AtEnd() && Peek() == '|')
+        {
+            ++m_pos;
+            if (!ParseConcatenation(branch, depth)) return false;
+            node.children.push_back(std::move(branch));
+        }
+        return true;
+    }
+
+    bool ParseConcatenation(Node& node, unsigned depth)
+    {
+        node = Node();
+        node.kind = Node::Kind::concatenation;
+        while (!AtEnd() && Peek() != '|' && Peek() != ')')
+        {
+            Node piece;
+            if (!ParseAtom(piece, depth) || !ParseQuantifiers(piece)) return false;
+            node.children.push_back(std::move(piece));
+        }
+        return true;
+    }
+
+    bool ParseQuantifiers(Node& node)
+    {
+        while (!AtEnd())
+        {
+            uint32_t min = 0;
+            uint32_t max = Node::unbounded;
+            const char c = Peek();
+            if (c == '*' || c == '+' || c == '?')
+            {
+                ++m_pos;
+                if (c == '+') min = 1;
+                if (c == '?') max = 1;
+            }
+            else if (c != '{' || !ParseBounds(min, max))
+            {
+                return true;
+            }
+            if (min > maxRepeat || (max != Node::unbounded && (max > maxRepeat || max < min))) return Fail("bad repetition count");
+            const bool greedy = AtEnd() || Peek() != '?';
+            if (!greedy) ++m_pos;
+            Node repeat;
+            repeat.kind = Node::Kind::repeat;
+            repeat.min = min;
+            repeat.max = max;
+            repeat.greedy = greedy;
+            repeat.children.push_back(std::move(node));
+            node = std::move(repeat);
+        }
+        return true;
+    }
+
+    // {m} {m,} {m,n} , a '{' that starts none of these is an ordinary character
+    bool ParseBounds(uint32_t& min, uint32_t& max)
+    {
+        size_t pos = m_pos + 1;
+        auto number = [&](uint32_t& value)
+        {
+            const size_t begin = pos;
+            while (pos < m_pattern.size() && compiler_output_parser_detail::IsDigit(m_pattern[pos]) && pos - begin < 9) ++pos;
+            value = compiler_output_parser_detail::ParseNumber(m_pattern.substr(begin, pos - begin));
+            return pos > begin;
+        };
+        if (!number(min)) return false;
+        max = min;
+        if (pos < m_pattern.size() && m_pattern[pos] == ',')
+        {
+            ++pos;
+            if (!number(max)) max = Node::unbounded;
+        }
+        if (pos >= m_pattern.size() || m_pattern[pos] != '}') return false;
+        m_pos = pos + 1;
+        return true;
+    }
+
+    bool ParseAtom(Node& node, unsigned depth)
+    {
+        const char c = Peek();
+        switch (c)
+        {
+            case '(':
+            {
+                ++m_pos;
+                const bool capturing = !m_pattern.substr(m_pos).starts_with("?:");
+                if (!capturing) m_pos += 2;
+                const uint32_t group = capturing ? ++m_groupCount : 0;
+                Node inner;
+                if (!ParseAlternation(inner, depth + 1)) return false;
+                if (AtEnd()) return Fail("missing )");
+                ++m_pos;
+                if (!capturing)
+                {
+                    node = std::move(inner);
+                    return true;
+                }
+                node.kind = Node::Kind::group;
+                node.group = group;
+                node.children.push_back(std::move(inner));
+                return true;
+            }
+            case '[':
+                ++m_pos;
+                node.kind = Node::Kind::bytes;
+                return ParseBracket(node.bytes);
+            case '.':
+                ++m_pos;
+                node.kind = Node::Kind::bytes;
+                node.bytes.set();
+                return true;
+            case '\\':
+                node.kind = Node::Kind::bytes;
+                return ParseEscape(node.bytes);
+            case '*':
+            case '+':
+            case '?':
+                return Fail("nothing to repeat");
+            case '^':
+            case '$':
+                return Fail("anchors are only supported at the ends of the pattern");
+            default:
+                ++m_pos;
+                node.kind = Node::Kind::bytes;
+                node.bytes.set(static_cast<unsigned char>(c));
+                return true;
+        }
+    }
+
+    // The escape at m_pos, inside or outside a bracket expression
+    bool ParseEscape(ByteSet& set)
+    {
+        if (++m_pos == m_pattern.size()) return Fail("trailing \\");
+        const char c = m_pattern[m_pos++];
+        switch (c)
+        {
+            case 'd':
+            case 'D':
+                AddClass(set, "digit", c == 'D');
+                return true;
+            case 's':
+            case 'S':
+                AddClass(set, "space", c == 'S');
+                return true;
+            case 'w':
+            case 'W':
+                AddClass(set, "word", c == 'W');
+                return true;
+            case 't':
+                set.set('\t');
+                return true;
+            case 'n':
+                set.set('\n');
+                return true;
+            case 'r':
+                set.set('\r');
+                return true;
+            default:
+                set.set(static_cast<unsigned char>(c));
+                return true;
+        }
+    }
+
+    // After the '[': a ']' first is an ordinary character, as is a '-' first or last
+    bool ParseBracket(ByteSet& set)
+    {
+        const bool negated = !AtEnd() && Peek() == '^';
+        if (negated) ++m_pos;
+        bool first = true;
+        for (;;)
+        {
+            if (AtEnd()) return Fail("missing ]");
+            if (Peek() == ']' && !first) break;
+            first = false;
+            if (m_pattern.substr(m_pos).starts_with("[:"))
+            {
+                const size_t end = m_pattern.find(":]", m_pos + 2);
+                if (end == std::string_view::npos || !AddClass(set, m_pattern.substr(m_pos + 2, end - m_pos - 2), false))
+                {
+                    return Fail("unknown character class");
+                }
+                m_pos = end + 2;
+                continue;
+            }
+            ByteSet single;
+            if (Peek() == '\\')
+            {
+                if (!ParseEscape(single)) return false;
+                // A class such as \d cannot start a range
+                if (single.count() != 1)
+                {
+                    set |= single;
+                    continue;
+                }
+            }
+            else
+            {
+                single.set(static_cast<unsigned char>(m_pattern[m_pos++]));
+            }
+            unsigned low = 0;
+            while (!single.test(low)) ++low;
+            unsigned high = low;
+            if (m_pos + 1 < m_pattern.size() && Peek() == '-' && m_pattern[m_pos + 1] != ']')
+            {
+                ++m_pos;
+                if (Peek() == '\\')
+                {
+                    ByteSet end;
+                    if (!ParseEscape(end)) return false;
+                    if (end.count() != 1) return Fail("bad range");
+                    while (!end.test(high)) ++high;
+                }
+                else
+                {
+                    high = static_cast<unsigned char>(m_pattern[m_pos++]);
+                }
+                if (high < low) return Fail("bad range");
+            }
+            for (unsigned byte = low; byte <= high; ++byte) set.set(byte);
+        }
+        ++m_pos;
+        if (negated) set.flip();
+        return true;
+    }
+
+    static bool AddClass(ByteSet& set, std::string_view name, bool negated)
+    {
+        ByteSet bytes;
+        for (unsigned byte = 0; byte < 256; ++byte)
+        {
+            const char c = static_cast<char>(byte);
+            const bool digit = c >= '0' && c <= '9';
+            const bool upper = c >= 'A' && c <= 'Z';
+            const bool lower = c >= 'a' && c <= 'z';
+            bool in = false;
+            if (name == "alpha") in = upper || lower;
+            else if (name == "digit") in = digit;
+            else if (name == "alnum") in = upper || lower || digit;
+            else if (name == "word") in = upper || lower || digit || c == '_';
+            else if (name == "upper") in = upper;
+            else if (name == "lower") in = lower;
+            else if (name == "xdigit") in = digit || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+            else if (name == "blank") in = c == ' ' || c == '\t';
+            else if (name == "space") in = c == ' ' || (c >= '\t' && c <= '\r');
+            else if (name == "punct") in = byte > ' ' && byte < 0x7f && !upper && !lower && !digit;
+            else if (name == "print") in = byte >= ' ' && byte < 0x7f;
+            else if (name == "graph") in = byte > ' ' && byte < 0x7f;
+            else if (name == "cntrl") in = byte < ' ' || byte == 0x7f;
+            else return false;
+            bytes.set(byte, in);
+        }
+        set |= negated ? ~bytes : bytes;
+        return true;
+    }
+
+    std::string_view m_pattern;
+    size_t m_pos{0};
+    uint32_t m_groupCount{0};
+    std::string m_error;
+};
+
+struct Instruction
+{
+    enum class Op : uint8_t
+    {
+        bytes,  // consumes a byte of byteSets[x], goes on with the next instruction
+        split,  // goes on with x, then with y
+        jump,   // goes on with x
+        save,   // records the position in capture slot x
+        match   // the whole line matched rule x
+    };
+
+    Op op;
+    uint32_t x{0};
+    uint32_t y{0};
+};
+
+// Thompson construction of a Node into the instructions of a program
+class ProgramBuilder
+{
+public:
+    static constexpr size_t maxProgramSize = 1 << 20;
+
+    ProgramBuilder(std::vector<Instruction>& program, std::vector<ByteSet>& byteSets) : m_program(program), m_byteSets(byteSets) {}
+
+    bool Emit(const Node& node)
+    {
+        if (m_program.size() > maxProgramSize) return false;
+        switch (node.kind)
+        {
+            case Node::Kind::empty:
+                return true;
+            case Node::Kind::bytes:
+                Add(Instruction::Op::bytes, ByteSetIndex(node.bytes));
+                return true;
+            case Node::Kind::concatenation:
+                for (const Node& child : node.children)
+                {
+                    if (!Emit(child)) return false;
+                }
+                return true;
+            case Node::Kind::alternation:
+            {
+                std::vector<size_t> jumps;
+                for (size_t i = 0; i + 1 < node.children.size(); ++i)
+                {
+                    const size_t split = Add(Instruction::Op::split, Here() + 1);
+                    if (!Emit(node.children[i])) return false;
+                    jumps.push_back(Add(Instruction::Op::jump));
+                    m_program[split].y = Here();
+                }
+                if (!Emit(node.children.back())) return false;
+                for (size_t jump : jumps) m_program[jump].x = Here();
+                return true;
+            }
+            case Node::Kind::group:
+                Add(Instruction::Op::save, node.group * 2);
+                if (!Emit(node.children.front())) return false;
+                Add(Instruction::Op::save, node.group * 2 + 1);
+                return true;
+            case Node::Kind::repeat:
+                return EmitRepeat(node);
+        }
+        return false;
+    }
+
+    size_t Here() const { return m_program.size(); }
+
+    size_t Add(Instruction::Op op, size_t x = 0)
+    {
+        m_program.push_back({op, static_cast<uint32_t>(x), 0});
+        return m_program.size() - 1;
+    }
+
+private:
+    bool EmitRepeat(const Node& node)
+    {
+        const Node& body = node.children.front();
+        for (uint32_t i = 0; i < node.min; ++i)
+        {
+            if (!Emit(body)) return false;
+        }
+        if (node.max == Node::unbounded)
+        {
+            const size_t split = Add(Instruction::Op::split);
+            if (!Emit(body)) return false;
+            Add(Instruction::Op::jump, split);
+            SetBranches(split, split + 1, Here(), node.greedy);
+            return true;
+        }
+        std::vector<size_t> splits;
+        for (uint32_t i = node.min; i < node.max; ++i)
+        {
+            splits.push_back(Add(Instruction::Op::split));
+            if (!Emit(body)) return false;
+        }
+        for (size_t split : splits) SetBranches(split, split + 1, Here(), node.greedy);
+        return true;
+    }
+
+    // The greedy branch goes into the body first
+    void SetBranches(size_t split, size_t body, size_t out, bool greedy)
+    {
+        m_program[split].x = static_cast<uint32_t>(greedy ? body : out);
+        m_program[split].y = static_cast<uint32_t>(greedy ? out : body);
+    }
+
+    uint32_t ByteSetIndex(const ByteSet& bytes)
+    {
+        for (size_t i = 0; i < m_byteSets.size(); ++i)
+        {
+            if (m_byteSets[i] == bytes) return static_cast<uint32_t>(i);
+        }
+        m_byteSets.push_back(bytes);
+        return static_cast<uint32_t>(m_byteSets.size() - 1);
+    }
+
+    std::vector<Instruction>& m_program;
+    std::vector<ByteSet>& m_byteSets;
+};
+
+// Text between quotes or in an element, with the five predefined XML entities and character references replaced
+inline std::string DecodeXmlText(std::string_view text)
+{
+    std::string decoded;
+    decoded.reserve(text.size());
+    for (size_t pos = 0; pos < text.size(); ++pos)
+    {
+        const size_t semicolon = text[pos] == '&' ? text.find(';', pos) : std::string_view::npos;
+        if (semicolon == std::string_view::npos)
+        {
+            decoded += text[pos];
+            continue;
+        }
+        const std::string_view entity = text.substr(pos + 1, semicolon - pos - 1);
+        if (entity == "amp") decoded += '&';
+        else if (entity == "lt") decoded += '<';
+        else if (entity == "gt") decoded += '>';
+        else if (entity == "quot") decoded += '"';
+        else if (entity == "apos") decoded += '\'';
+        else if (entity.starts_with("#x")) decoded += static_cast<char>(strtoul(std::string(entity.substr(2)).c_str(), nullptr, 16));
+        else if (entity.starts_with('#')) decoded += static_cast<char>(strtoul(std::string(entity.substr(1)).c_str(), nullptr, 10));
+        else decoded += text.substr(pos, semicolon - pos + 1);
+        pos = semicolon;
+    }
+    return decoded;
+}
+
+// The value of attribute name in the attributes of a start tag, false when it is not there
+inline bool FindXmlAttribute(std::string_view attributes, std::string_view name, std::string& value)
+{
+    size_t pos = 0;
+    while (pos < attributes.size())
+    {
+        const size_t equals = attributes.find('=', pos);
+        if (equals == std::string_view::npos) return false;
+        std::string_view attribute = attributes.substr(pos, equals - pos);
+        while (!attribute.empty() && isspace(static_cast<unsigned char>(attribute.front()))) attribute.remove_prefix(1);
+        while (!attribute.empty() && isspace(static_cast<unsigned char>(attribute.back()))) attribute.remove_suffix(1);
+        size_t quote = equals + 1;
+        while (quote < attributes.size() && isspace(static_cast<unsigned char>(attributes[quote]))) ++quote;
+        if (quote >= attributes.size() || (attributes[quote] != '"' && attributes[quote] != '\'')) return false;
+        const size_t end = attributes.find(attributes[quote], quote + 1);
+        if (end == std::string_view::npos) return false;
+        if (attribute == name)
+        {
+            value = DecodeXmlText(attributes.substr(quote + 1, end - quote - 1));
+            return true;
+        }
+        pos = end + 1;
+    }
+    return false;
+}
+}  // namespace compiler_output_runtime_detail
+
+// A rule of a runtime rule set, the group numbers are 0 for a field the rule does not capture
+struct CompilerOutputRuntimeRule
+{
+    std::string name;
+    std::string pattern;
+    CompilerOutputLineType type{CompilerOutputLineType::normal};
+    // Reported in the views, see CompilerOutputRuntimeParser::MapRuleNames()
+    CompilerOutputRule rule{CompilerOutputRule::none};
+    size_t fileNameIdx{0};
+    size_t lineIdx{0};
+    size_t columnIdx{0};
+    size_t messageIdx{0};
+};
+
+/*
+ * Parses lines with rules loaded at run time. Rules are tried in the order they were loaded and the first one whose
+ * pattern is found in the line wins, like the rules of a CompilerOutputRuleSet. Parse() may be called from several
+ * threads at once.
+ */
+class CompilerOutputRuntimeParser
+{
+public:
+    static constexpr size_t noRule = SIZE_MAX;
+    // DFA states kept by a thread before it starts over
+    static constexpr size_t maxCachedStates = 1 << 16;
+
+    // Adds a rule, the DFA is built by Compile(), returns false with error set for a pattern that cannot be parsed
+    bool AddRule(CompilerOutputRuntimeRule rule, std::string& error)
+    {
+        using namespace compiler_output_runtime_detail;
+        Node root;
+        uint32_t groupCount = 0;
+        if (!PatternParser(rule.pattern).Parse(root, groupCount, error))
+        {
+            error = "rule '" + rule.name + "': " + error;
+            return false;
+        }
+        if (std::max({rule.fileNameIdx, rule.lineIdx, rule.columnIdx, rule.messageIdx}) > groupCount)
+        {
+            error = "rule '" + rule.name + "': the pattern has " + std::to_string(groupCount) + " groups only";
+            return false;
+        }
+        // The views report the rule in 16 bits
+        if (m_rules.size() >= CompilerOutputLineView::noRuntimeRule)
+        {
+            error = "rule '" + rule.name + "': too many rules";
+            return false;
+        }
+        ProgramBuilder builder(m_program, m_byteSets);
+        const size_t start = builder.Here();
+        if (!builder.Emit(root))
+        {
+            error = "rule '" + rule.name + "': pattern too large";
+            return false;
+        }
+        builder.Add(Instruction::Op::match, m_rules.size());
+        m_starts.push_back(static_cast<uint32_t>(start));
+        m_groupCounts.push_back(groupCount);
+        m_rules.push_back(std::move(rule));
+        m_compiled = false;
+        return true;
+    }
+
+    /*
+     * Adds the <RegEx> elements of a Code::Blocks compiler XML, in their order:
+     *   <RegEx name="Compiler warning" type="warning" msg="3" file="1" line="2"><![CDATA[pattern]]></RegEx>
+     * msg, file and line are group numbers, msg="3;4" uses the first one. column is accepted as well. Compile() is called
+     * at the end, returns false with error set when a rule cannot be read.
+     */
+    bool LoadCodeBlocksXml(std::string_view xml, std::string& error)
+    {
+        using namespace compiler_output_runtime_detail;
+        size_t pos = 0;
+        for (;;)
+        {
+            const size_t comment = xml.find("<!--", pos);
+            const size_t element = xml.find("<RegEx", pos);
+            if (comment < element)
+            {
+                const size_t commentEnd = xml.find("-->", comment + 4);
+                if (commentEnd == std::string_view::npos) return XmlError("unterminated comment", error);
+                pos = commentEnd + 3;
+                continue;
+            }
+            if (element == std::string_view::npos) break;
+            const size_t tagEnd = xml.find('>', element);
+            if (tagEnd == std::string_view::npos) return XmlError("unterminated <RegEx", error);
+            pos = tagEnd + 1;
+            const std::string_view attributes = xml.substr(element + 6, tagEnd - element - 6);
+            if (!attributes.empty() && !isspace(static_cast<unsigned char>(attributes.front())) && attributes.front() != '/') continue;
+            if (attributes.ends_with('/')) return XmlError("<RegEx> without a pattern", error);
+            const size_t close = xml.find("</RegEx>", pos);
+            if (close == std::string_view::npos) return XmlError("missing </RegEx>", error);
+            CompilerOutputRuntimeRule rule;
+            if (!ReadXmlRule(attributes, xml.substr(pos, close - pos), rule, error) || !AddRule(std::move(rule), error)) return false;
+            pos = close + 8;
+        }
+        if (m_rules.empty()) return XmlError("no <RegEx> rules", error);
+        Compile();
+        return true;
+    }
+
+    /*
+     * Prepares the DFA of all the rules added so far. Each DFA state is the set of places the rules can be at after the
+     * bytes read so far and, for the end of the line, the first rule that has matched. The DFA is built lazily: a state is
+     * added the first time a line leads to it. Each rule keeps its own choice of the ':' that ends the file name, so the
+     * whole DFA of the built-in rules has well over a hundred thousand states, of which a build log visits a few hundred.
+     * Bytes that no pattern tells apart share a column of the transition table.
+     */
+    void Compile()
+    {
+        ComputeByteClasses();
+        std::vector<uint32_t> marks(m_program.size(), 0);
+        m_startState = Closure(std::vector<uint32_t>(m_starts.begin(), m_starts.end()), marks, 1);
+        m_id = NextId();
+        m_compiled = true;
+    }
+
+    // The index of the rule that matches line, noRule when none does or Compile() was not called
+    size_t Classify(std::string_view line) const
+    {
+        if (!m_compiled) return noRule;
+        DfaCache& cache = CacheOf();
+        uint32_t state = startState;
+        for (char c : line)
+        {
+            const uint8_t byteClass = m_byteClasses[static_cast<unsigned char>(c)];
+            uint32_t next = cache.transitions[state * m_classCount + byteClass];
+            if (next == unknownState) next = AddTransition(cache, state, byteClass);
+            if (next == deadState) return noRule;
+            state = next;
+        }
+        return cache.accepting[state];
+    }
+
+    CompilerOutputLineView Parse(std::string_view line) const
+    {
+        const size_t ruleIndex = Classify(line);
+        return ruleIndex == noRule ? CompilerOutputLineView() : Extract(ruleIndex, line);
+    }
+
+    // Parse(line) with the diagnostics filter does not select as normal lines, groups are only matched for a rule of a selected type
+    CompilerOutputLineView Parse(std::string_view line, const CompilerOutputFilter& filter) const
+    {
+        const size_t ruleIndex = Classify(line);
+        if (ruleIndex == noRule || !filter.SelectsType(m_rules[ruleIndex].type)) return {};
+        if (!filter.filePrefix.empty() && !m_rules[ruleIndex].fileNameIdx) return {};
+        const CompilerOutputLineView view = Extract(ruleIndex, line);
+        return filter.Selects(view) ? view : CompilerOutputLineView();
+    }
+
+    /*
+     * Reports the built-in CompilerOutputRule of each rule named like one in the views, ruleName is
+     * GetCompilerOutputRuleName. Rules of other names are reported as CompilerOutputRule::none.
+     */
+    void MapRuleNames(const char* (*ruleName)(CompilerOutputRule))
+    {
+        for (CompilerOutputRuntimeRule& rule : m_rules)
+        {
+            for (size_t value = 1; value < compilerOutputRuleCount; ++value)
+            {
+                if (rule.name == ruleName(static_cast<CompilerOutputRule>(value))) rule.rule = static_cast<CompilerOutputRule>(value);
+            }
+        }
+    }
+
+    const std::vector<CompilerOutputRuntimeRule>& Rules() const { return m_rules; }
+
+    // DFA states the calling thread has built so far
+    size_t CachedStateCount() const { return CacheOf().states.size(); }
+
+private:
+    static constexpr uint32_t deadState = 0;
+    static constexpr uint32_t startState = 1;
+    static constexpr uint32_t unknownState = UINT32_MAX;
+    static constexpr size_t noPosition = SIZE_MAX;
+    // Instructions times positions, a bit each
+    static constexpr size_t maxBacktrackStates = 1 << 22;
+    // The job restores capture slot to pos
+    static constexpr uint32_t restoreCapture = UINT32_MAX;
+
+    // The view of the rule at ruleIndex, which matches line
+    CompilerOutputLineView Extract(size_t ruleIndex, std::string_view line) const
+    {
+        const CompilerOutputRuntimeRule& rule = m_rules[ruleIndex];
+        CompilerOutputLineView view;
+        const std::vector<size_t>& captures = Captures(ruleIndex, line);
+        auto group = [&](size_t index)
+        {
+            const size_t begin = captures[index * 2];
+            const size_t end = captures[index * 2 + 1];
+            return begin == noPosition || end == noPosition ? std::string_view() : line.substr(begin, end - begin);
+        };
+        view.type = rule.type;
+        view.rule = rule.rule;
+        view.runtimeRule = static_cast<uint16_t>(ruleIndex);
+        if (rule.fileNameIdx) view.fileName = group(rule.fileNameIdx);
+        if (rule.lineIdx) view.line = compiler_output_parser_detail::ParseNumber(group(rule.lineIdx));
+        if (rule.columnIdx) view.column = compiler_output_parser_detail::ParseNumber(group(rule.columnIdx));
+        if (rule.messageIdx) view.message = group(rule.messageIdx);
+        return view;
+    }
+
+    static bool XmlError(std::string message, std::string& error)
+    {
+        error = std::move(message);
+        return false;
+    }
+
+    static bool ReadXmlRule(std::string_view attributes, std::string_view content, CompilerOutputRuntimeRule& rule, std::string& error)
+    {
+        using namespace compiler_output_runtime_detail;
+        std::string type;
+        FindXmlAttribute(attributes, "name", rule.name);
+        FindXmlAttribute(attributes, "type", type);
+        if (type == "error") rule.type = CompilerOutputLineType::error;
+        else if (type == "warning") rule.type = CompilerOutputLineType::warning;
+        else if (type == "info") rule.type = CompilerOutputLineType::info;
+        else if (type == "normal") rule.type = CompilerOutputLineType::normal;
+        else return XmlError("rule '" + rule.name + "': unknown type '" + type + "'", error);
+        auto groupNumber = [&attributes](std::string_view name, size_t& number)
+        {
+            std::string value;
+            if (FindXmlAttribute(attributes, name, value)) number = strtoul(value.c_str(), nullptr, 10);
+        };
+        groupNumber("msg", rule.messageIdx);
+        groupNumber("file", rule.fileNameIdx);
+        groupNumber("line", rule.lineIdx);
+        groupNumber("column", rule.columnIdx);
+
+        while (!content.empty() && isspace(static_cast<unsigned char>(content.front()))) content.remove_prefix(1);
+        while (!content.empty() && isspace(static_cast<unsigned char>(content.back()))) content.remove_suffix(1);
+        if (content.starts_with("<![CDATA["))
+        {
+            const size_t end = content.find("]]>");
+            if (end == std::string_view::npos) return XmlError("rule '" + rule.name + "': unterminated CDATA", error);
+            rule.pattern = content.substr(9, end - 9);
+        }
+        else
+        {
+            rule.pattern = DecodeXmlText(content);
+        }
+        return true;
+    }
+
+    // The bytes and match instructions reached from seeds without consuming a byte, sorted, marks[pc] is set to generation
+    std::vector<uint32_t> Closure(const std::vector<uint32_t>& seeds, std::vector<uint32_t>& marks, uint32_t generation) const
+    {
+        using namespace compiler_output_runtime_detail;
+        std::vector<uint32_t> pending(seeds.rbegin(), seeds.rend());
+        std::vector<uint32_t> state;
+        while (!pending.empty())
+        {
+            const uint32_t pc = pending.back();
+            pending.pop_back();
+            if (marks[pc] == generation) continue;
+            marks[pc] = generation;
+            const Instruction& instruction = m_program[pc];
+            switch (instruction.op)
+            {
+                case Instruction::Op::split:
+                    pending.push_back(instruction.y);
+                    pending.push_back(instruction.x);
+                    break;
+                case Instruction::Op::jump:
+                    pending.push_back(instruction.x);
+                    break;
+                case Instruction::Op::save:
+                    pending.push_back(pc + 1);
+                    break;
+                default:
+                    state.push_back(pc);
+                    break;
+            }
+        }
+        std::sort(state.begin(), state.end());
+        return state;
+    }
+
+    /*
+     * The DFA states a thread went through, for the parser that used it last. Another parser on the same thread, or more
+     * than maxCachedStates states, start it over.
+     */
+    struct DfaCache
+    {
+        uint64_t owner{0};
+        std::map<std::vector<uint32_t>, uint32_t> ids;
+        std::vector<const std::vector<uint32_t>*> states;
+        std::vector<uint32_t> transitions;
+        std::vector<size_t> accepting;
+        std::vector<uint32_t> marks;
+        uint32_t generation{0};
+    };
+
+    static uint64_t NextId()
+    {
+        static std::atomic<uint64_t> nextId{1};
+        return nextId.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    DfaCache& CacheOf() const
+    {
+        thread_local DfaCache cache;
+        if (cache.owner != m_id) ResetCache(cache);
+        return cache;
+    }
+
+    void ResetCache(DfaCache& cache) const
+    {
+        cache.owner = m_id;
+        cache.ids.clear();
+        cache.states.clear();
+        cache.transitions.clear();
+        cache.accepting.clear();
+        cache.marks.assign(m_program.size(), 0);
+        cache.generation = 0;
+        AddState(cache, {});
+        AddState(cache, std::vector<uint32_t>(m_startState));
+    }
+
+    uint32_t AddState(DfaCache& cache, std::vector<uint32_t>&& state) const
+    {
+        using namespace compiler_output_runtime_detail;
+        const auto [it, added] = cache.ids.emplace(std::move(state), static_cast<uint32_t>(cache.states.size()));
+        if (!added) return it->second;
+        size_t accepting = noRule;
+        for (uint32_t pc : it->first)
+        {
+            if (m_program[pc].op == Instruction::Op::match) accepting = std::min<size_t>(accepting, m_program[pc].x);
+        }
+        cache.states.push_back(&it->first);
+        cache.accepting.push_back(accepting);
+        cache.transitions.resize(cache.transitions.size() + m_classCount, unknownState);
+        return it->second;
+    }
+
+    // The state after state on a byte of byteClass, added to the cache
+    uint32_t AddTransition(DfaCache& cache, uint32_t& state, uint8_t byteClass) const
+    {
+        using namespace compiler_output_runtime_detail;
+        if (cache.states.size() >= maxCachedStates)
+        {
+            std::vector<uint32_t> current = *cache.states[state];
+            ResetCache(cache);
+            state = AddState(cache, std::move(current));
+        }
+        const unsigned byte = m_classBytes[byteClass];
+        std::vector<uint32_t> seeds;
+        for (uint32_t pc : *cache.states[state])
+        {
+            const Instruction& instruction = m_program[pc];
+            if (instruction.op == Instruction::Op::bytes && m_byteSets[instruction.x].test(byte)) seeds.push_back(pc + 1);
+        }
+        const uint32_t next = seeds.empty() ? deadState : AddState(cache, Closure(seeds, cache.marks, ++cache.generation));
+        cache.transitions[state * m_classCount + byteClass] = next;
+        return next;
+    }
+
+    void ComputeByteClasses()
+    {
+        std::map<std::vector<bool>, uint8_t> classIds;
+        m_classBytes.clear();
+        for (unsigned byte = 0; byte < 256; ++byte)
+        {
+            std::vector<bool> signature(m_byteSets.size());
+            for (size_t i = 0; i < m_byteSets.size(); ++i) signature[i] = m_byteSets[i].test(byte);
+            const auto [it, added] = classIds.emplace(std::move(signature), static_cast<uint8_t>(m_classBytes.size()));
+            if (added) m_classBytes.push_back(byte);
+            m_byteClasses[byte] = it->second;
+        }
+        m_classCount = m_classBytes.size();
+    }
+
+    // Capture positions of the rule that matched line, the groups a backtracking matcher would find
+    const std::vector<size_t>& Captures(size_t ruleIndex, std::string_view line) const
+    {
+        const size_t end = ruleIndex + 1 < m_starts.size() ? m_starts[ruleIndex + 1] : m_program.size();
+        const size_t programSize = end - m_starts[ruleIndex];
+        if (programSize * (line.size() + 1) <= maxBacktrackStates) return BacktrackCaptures(ruleIndex, programSize, line);
+        return PikeCaptures(ruleIndex, line);
+    }
+
+    /*
+     * Backtracking that tries the branches in priority order and never tries an instruction at a position twice: the
+     * first try that failed there would fail again. Linear in the size of the program times the length of the line, so
+     * it is only used when their product is small, but much faster than the Pike VM then.
+     */
+    const std::vector<size_t>& BacktrackCaptures(size_t ruleIndex, size_t programSize, std::string_view line) const
+    {
+        using namespace compiler_output_runtime_detail;
+        ThreadStorage& storage = ThreadStorageOf();
+        const size_t slots = (m_groupCounts[ruleIndex] + 1) * 2;
+        const uint32_t start = m_starts[ruleIndex];
+        const size_t columns = line.size() + 1;
+        storage.visited.assign((programSize * columns + 63) / 64, 0);
+        storage.captures.assign(slots, noPosition);
+        storage.result.assign(slots, noPosition);
+        std::vector<BacktrackJob>& jobs = storage.jobs;
+        jobs.clear();
+        jobs.push_back({start, 0, 0});
+        while (!jobs.empty())
+        {
+            BacktrackJob job = jobs.back();
+            jobs.pop_back();
+            if (job.pc == restoreCapture)
+            {
+                storage.captures[job.slot] = job.pos;
+                continue;
+            }
+            for (;;)
+            {
+                const size_t bit = (job.pc - start) * columns + job.pos;
+                if (storage.visited[bit / 64] & (uint64_t(1) << (bit % 64))) break;
+                storage.visited[bit / 64] |= uint64_t(1) << (bit % 64);
+                const Instruction& instruction = m_program[job.pc];
+                if (instruction.op == Instruction::Op::bytes)
+                {
+                    if (job.pos == line.size() || !m_byteSets[instruction.x].test(static_cast<unsigned char>(line[job.pos]))) break;
+                    ++job.pc;
+                    ++job.pos;
+                }
+                else if (instruction.op == Instruction::Op::split)
+                {
+                    jobs.push_back({instruction.y, 0, job.pos});
+                    job.pc = instruction.x;
+                }
+                else if (instruction.op == Instruction::Op::jump)
+                {
+                    job.pc = instruction.x;
+                }
+                else if (instruction.op == Instruction::Op::save)
+                {
+                    jobs.push_back({restoreCapture, instruction.x, storage.captures[instruction.x]});
+                    storage.captures[instruction.x] = job.pos;
+                    ++job.pc;
+                }
+                else
+                {
+                    if (job.pos < line.size()) break;
+                    storage.result = storage.captures;
+                    return storage.result;
+                }
+            }
+        }
+        return storage.result;
+    }
+
+    /*
+     * Capture positions by a Pike VM over the instructions of the rule: the threads are kept in priority order and the
+     * first one to reach the match at the end of the line has the groups a backtracking matcher would find, in time
+     * linear in the length of the line.
+     */
+    const std::vector<size_t>& PikeCaptures(size_t ruleIndex, std::string_view line) const
+    {
+        using namespace compiler_output_runtime_detail;
+        ThreadStorage& storage = ThreadStorageOf();
+        const size_t slots = (m_groupCounts[ruleIndex] + 1) * 2;
+        storage.Reset(m_program.size(), slots);
+        std::vector<size_t>& captures = storage.captures;
+        captures.assign(slots, noPosition);
+        AddThread(storage.current, m_starts[ruleIndex], 0, captures, storage.jobs);
+        storage.result.assign(slots, noPosition);
+        for (size_t pos = 0; pos <= line.size(); ++pos)
+        {
+            storage.next.Clear();
+            for (size_t i = 0; i < storage.current.Size(); ++i)
+            {
+                const uint32_t pc = storage.current.pcs[i];
+                const Instruction& instruction = m_program[pc];
+                const size_t* threadCaptures = storage.current.Captures(i);
+                if (instruction.op == Instruction::Op::match)
+                {
+                    if (pos < line.size()) continue;
+                    storage.result.assign(threadCaptures, threadCaptures + slots);
+                    break;
+                }
+                if (pos == line.size() || !m_byteSets[instruction.x].test(static_cast<unsigned char>(line[pos]))) continue;
+                captures.assign(threadCaptures, threadCaptures + slots);
+                AddThread(storage.next, pc + 1, pos + 1, captures, storage.jobs);
+            }
+            std::swap(storage.current, storage.next);
+        }
+        return storage.result;
+    }
+
+    // Threads of the Pike VM, at most one per instruction, with their capture slots side by side
+    struct ThreadList
+    {
+        std::vector<uint32_t> pcs;
+        std::vector<size_t> captures;
+        std::vector<uint32_t> marks;
+        uint32_t generation{0};
+        size_t slots{0};
+
+        void Reset(size_t programSize, size_t slotCount)
+        {
+            slots = slotCount;
+            marks.assign(programSize, 0);
+            generation = 0;
+            Clear();
+        }
+        void Clear()
+        {
+            pcs.clear();
+            captures.clear();
+            ++generation;
+        }
+        // Marks pc as seen, false when it already was
+        bool Visit(uint32_t pc)
+        {
+            if (marks[pc] == generation) return false;
+            marks[pc] = generation;
+            return true;
+        }
+        void Push(uint32_t pc, const std::vector<size_t>& threadCaptures)
+        {
+            pcs.push_back(pc);
+            captures.insert(captures.end(), threadCaptures.begin(), threadCaptures.end());
+        }
+        size_t Size() const { return pcs.size(); }
+        const size_t* Captures(size_t i) const { return captures.data() + i * slots; }
+    };
+
+    struct BacktrackJob
+    {
+        uint32_t pc;
+        uint32_t slot;
+        size_t pos;
+    };
+
+    struct ThreadStorage
+    {
+        ThreadList current;
+        ThreadList next;
+        std::vector<BacktrackJob> jobs;
+        std::vector<uint64_t> visited;
+        std::vector<size_t> captures;
+        std::vector<size_t> result;
+
+        void Reset(size_t programSize, size_t slots)
+        {
+            current.Reset(programSize, slots);
+            next.Reset(programSize, slots);
+        }
+    };
+
+    /*
+     * Follows the instructions that consume no byte, in priority order, a save being undone once its branch is added.
+     * The branches wait on jobs rather than on the call stack, a long run of such instructions cannot overflow it.
+     */
+    void AddThread(ThreadList& list, uint32_t pc, size_t pos, std::vector<size_t>& captures, std::vector<BacktrackJob>& jobs) const
+    {
+        using namespace compiler_output_runtime_detail;
+        jobs.clear();
+        jobs.push_back({pc, 0, pos});
+        while (!jobs.empty())
+        {
+            BacktrackJob job = jobs.back();
+            jobs.pop_back();
+            if (job.pc == restoreCapture)
+            {
+                captures[job.slot] = job.pos;
+                continue;
+            }
+            while (list.Visit(job.pc))
+            {
+                const Instruction& instruction = m_program[job.pc];
+                if (instruction.op == Instruction::Op::split)
+                {
+                    jobs.push_back({instruction.y, 0, pos});
+                    job.pc = instruction.x;
+                }
+                else if (instruction.op == Instruction::Op::jump)
+                {
+                    job.pc = instruction.x;
+                }
+                else if (instruction.op == Instruction::Op::save)
+                {
+                    jobs.push_back({restoreCapture, instruction.x, captures[instruction.x]});
+                    captures[instruction.x] = pos;
+                    ++job.pc;
+                }
+                else
+                {
+                    list.Push(job.pc, captures);
+                    break;
+                }
+            }
+        }
+    }
+
+    // Scratch space of the thread, only one match runs per thread at a time
+    static ThreadStorage& ThreadStorageOf()
+    {
+        thread_local ThreadStorage storage;
+        return storage;
+    }
+
+    std::vector<CompilerOutputRuntimeRule> m_rules;
+    std::vector<compiler_output_runtime_detail::Instruction> m_program;
+    std::vector<compiler_output_runtime_detail::ByteSet> m_byteSets;
+    std::vector<uint32_t> m_starts;
+    std::vector<uint32_t> m_groupCounts;
+    std::array<uint8_t, 256> m_byteClasses{};
+    std::vector<unsigned> m_classBytes;
+    size_t m_classCount{0};
+    std::vector<uint32_t> m_startState;
+    uint64_t m_id{0};
+    bool m_compiled{false};
+};
+
+#endif  // COMPILER_OUTPUT_RUNTIME_RULES_HPP_INCLUDED
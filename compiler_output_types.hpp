@@ -0,0 +1,943 @@
+/*
+ * Compiler Output Parser: Parse error, warning and messages
+ * Copyright (C) 2024  Christo Joseph
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMPILER_OUTPUT_TYPES_HPP_INCLUDED
+#define COMPILER_OUTPUT_TYPES_HPP_INCLUDED
+
+/*
+ * Results of the parser and the containers built on them. Nothing here depends on the rules, so this is shared by the
+ * header only parser (compiler_output_parser.hpp) and the compiled library (compiler_output_parser_lib.hpp).
+ */
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#if !defined(COMPILER_OUTPUT_PARSER_NO_SIMD) && (defined(__AVX2__) || defined(__SSE2__))
+#include <immintrin.h>
+#endif
+
+enum class CompilerOutputLineType
+{
+    normal,
+    warning,
+    error,
+    info
+};
+
+struct CompilerOutputLineInfo
+{
+    CompilerOutputLineType type;
+    std::string fileName;
+    std::string line;
+    std::string message;
+};
+
+// One entry per rule of DefaultCompilerOutputRuleSet, in the order they are tried
+enum class CompilerOutputRule : uint8_t
+{
+    none,
+    fatalError,
+    inFunctionInfo,
+    skippingInstantiationContextsInfo2,
+    skippingInstantiationContextsInfo,
+    inInstantiationWarning,
+    requiredFromWarning,
+    instantiatedFromInfo2,
+    instantiatedFromInfo,
+    resourceCompilerError,
+    resourceCompilerError2,
+    preprocessorWarning,
+    compilerNote2,
+    compilerNote,
+    generalNote,
+    preprocessorError,
+    compilerWarning,
+    undefinedReference2,
+    compilerError,
+    linkerWarning,
+    linkerError2,
+    linkerError3,
+    linkerErrorLibNotFound,
+    linkerErrorCannotOpenOutputFile,
+    linkerErrorUnrecognizedOption,
+    compilerErrorUnrecognizedOption,
+    noSuchFileOrDirectory,
+    undefinedReference,
+    generalError,
+    generalWarning,
+    autoImportInfo,
+    linkerWarningDifferentSizedSections
+};
+
+// Number of CompilerOutputRule values, none included
+inline constexpr size_t compilerOutputRuleCount = static_cast<size_t>(CompilerOutputRule::linkerWarningDifferentSizedSections) + 1;
+
+/*
+ * Non owning result of GetCompilerOutputLineView, fileName and message point into the parsed line.
+ * Use MakeCompilerOutputLineInfo to keep a result after the line buffer is reused.
+ */
+struct CompilerOutputLineView
+{
+    static constexpr uint32_t noNumber = UINT32_MAX;
+    static constexpr uint16_t noRuntimeRule = UINT16_MAX;
+
+    CompilerOutputLineType type{CompilerOutputLineType::normal};
+    CompilerOutputRule rule{CompilerOutputRule::none};
+    // Index of the rule of a CompilerOutputRuntimeParser that matched, for rules with no built-in name
+    uint16_t runtimeRule{noRuntimeRule};
+    uint32_t line{noNumber};
+    uint32_t column{noNumber};
+    std::string_view fileName;
+    std::string_view message;
+};
+
+constexpr uint32_t CompilerOutputTypeBit(CompilerOutputLineType type) { return 1u << static_cast<unsigned>(type); }
+
+// The diagnostics a filtered parse keeps: those of the selected types, in a file whose name starts with filePrefix when it is set
+struct CompilerOutputFilter
+{
+    static constexpr uint32_t allTypes = CompilerOutputTypeBit(CompilerOutputLineType::warning) |
+                                         CompilerOutputTypeBit(CompilerOutputLineType::error) | CompilerOutputTypeBit(CompilerOutputLineType::info);
+
+    uint32_t types{allTypes};
+    std::string_view filePrefix;
+
+    bool IsEmpty() const { return (types & allTypes) == allTypes && filePrefix.empty(); }
+    bool SelectsType(CompilerOutputLineType type) const { return type != CompilerOutputLineType::normal && (types & CompilerOutputTypeBit(type)); }
+    bool Selects(const CompilerOutputLineView& view) const { return SelectsType(view.type) && view.fileName.starts_with(filePrefix); }
+};
+
+namespace compiler_output_parser_detail
+{
+constexpr bool IsBlank(char c) { return c == ' ' || c == '\t'; }
+constexpr bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+// [0-9]+ , saturated below CompilerOutputLineView::noNumber
+constexpr uint32_t ParseNumber(std::string_view digits)
+{
+    uint64_t number = 0;
+    for (char c : digits)
+    {
+        number = number * 10 + static_cast<uint32_t>(c - '0');
+        if (number >= CompilerOutputLineView::noNumber) return CompilerOutputLineView::noNumber - 1;
+    }
+    return static_cast<uint32_t>(number);
+}
+}  // namespace compiler_output_parser_detail
+
+inline CompilerOutputLineInfo MakeCompilerOutputLineInfo(const CompilerOutputLineView& view)
+{
+    CompilerOutputLineInfo info{.type = view.type, .fileName = std::string(view.fileName), .line = {}, .message = std::string(view.message)};
+    if (view.line != CompilerOutputLineView::noNumber) info.line = std::to_string(view.line);
+    return info;
+}
+
+/*
+ * CompilerOutputLineInfo with its strings allocated from a memory resource. With a std::pmr::monotonic_buffer_resource
+ * per batch of results, the strings of the batch are carved out of a few large blocks and released all at once with the
+ * resource, instead of being allocated and freed one by one from the global heap. It is allocator aware, so a
+ * std::pmr::vector of them puts the strings in the resource of the vector.
+ */
+struct CompilerOutputPmrLineInfo
+{
+    using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+    CompilerOutputPmrLineInfo() = default;
+    explicit CompilerOutputPmrLineInfo(const allocator_type& allocator) : fileName(allocator), line(allocator), message(allocator) {}
+    CompilerOutputPmrLineInfo(const CompilerOutputPmrLineInfo& other, const allocator_type& allocator)
+        : type(other.type), fileName(other.fileName, allocator), line(other.line, allocator), message(other.message, allocator)
+    {
+    }
+    CompilerOutputPmrLineInfo(CompilerOutputPmrLineInfo&& other, const allocator_type& allocator)
+        : type(other.type), fileName(std::move(other.fileName), allocator), line(std::move(other.line), allocator),
+          message(std::move(other.message), allocator)
+    {
+    }
+    CompilerOutputPmrLineInfo(const CompilerOutputPmrLineInfo&) = default;
+    CompilerOutputPmrLineInfo(CompilerOutputPmrLineInfo&&) = default;
+    CompilerOutputPmrLineInfo& operator=(const CompilerOutputPmrLineInfo&) = default;
+    CompilerOutputPmrLineInfo& operator=(CompilerOutputPmrLineInfo&&) = default;
+
+    allocator_type get_allocator() const { return fileName.get_allocator(); }
+
+    CompilerOutputLineType type{CompilerOutputLineType::normal};
+    std::pmr::string fileName;
+    std::pmr::string line;
+    std::pmr::string message;
+};
+
+inline CompilerOutputPmrLineInfo MakeCompilerOutputLineInfo(const CompilerOutputLineView& view, std::pmr::memory_resource* resource)
+{
+    CompilerOutputPmrLineInfo info(resource);
+    info.type = view.type;
+    info.fileName = view.fileName;
+    info.message = view.message;
+    if (view.line != CompilerOutputLineView::noNumber)
+    {
+        // Digits written in place, no std::string on the way
+        char digits[10];
+        char* begin = digits + sizeof(digits);
+        uint32_t number = view.line;
+        do
+        {
+            *--begin = static_cast<char>('0' + number % 10);
+            number /= 10;
+        } while (number);
+        info.line.assign(begin, digits + sizeof(digits));
+    }
+    return info;
+}
+
+// Calls onLine(std::string_view) for every line of data, without its "\n" or "\r\n"
+template <typename OnLine>
+void ForEachCompilerOutputLine(std::string_view data, OnLine&& onLine)
+{
+    const char* pos = data.data();
+    const char* const end = pos + data.size();
+    while (pos < end)
+    {
+        const char* newline = static_cast<const char*>(memchr(pos, '\n', static_cast<size_t>(end - pos)));
+        const char* lineEnd = newline ? newline : end;
+        std::string_view line(pos, static_cast<size_t>(lineEnd - pos));
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        onLine(line);
+        pos = newline ? newline + 1 : end;
+    }
+}
+
+namespace compiler_output_parser_detail
+{
+constexpr char escape = '\x1b';
+
+// Offset of the first ESC in data, size when there is none
+inline size_t FindEscape(const char* data, size_t size)
+{
+    size_t pos = 0;
+#if !defined(COMPILER_OUTPUT_PARSER_NO_SIMD) && defined(__AVX2__)
+    const __m256i escapes256 = _mm256_set1_epi8(escape);
+    for (; pos + 32 <= size; pos += 32)
+    {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+        const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, escapes256)));
+        if (mask) return pos + std::countr_zero(mask);
+    }
+#endif
+#if !defined(COMPILER_OUTPUT_PARSER_NO_SIMD) && defined(__SSE2__)
+    const __m128i escapes128 = _mm_set1_epi8(escape);
+    for (; pos + 16 <= size; pos += 16)
+    {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, escapes128)));
+        if (mask) return pos + std::countr_zero(mask);
+    }
+#endif
+    for (; pos < size; ++pos)
+    {
+        if (data[pos] == escape) return pos;
+    }
+    return size;
+}
+
+/*
+ * Length of the escape sequence starting with the ESC at data[0]: a CSI sequence (ESC [ parameters intermediates
+ * final byte) such as the SGR and erase in line sequences of -fdiagnostics-color, an OSC sequence (ESC ] ... BEL or
+ * ESC \) such as the hyperlinks of -fdiagnostics-urls, or ESC and one more byte. A sequence never goes past a newline,
+ * one cut short ends before it.
+ */
+inline size_t EscapeSequenceLength(const char* data, size_t size)
+{
+    if (size < 2) return size;
+    size_t pos = 2;
+    if (data[1] == '[')
+    {
+        while (pos < size && data[pos] >= 0x20 && data[pos] <= 0x3f) ++pos;
+        if (pos < size && data[pos] >= 0x40 && data[pos] <= 0x7e) ++pos;
+        return pos;
+    }
+    if (data[1] == ']')
+    {
+        for (; pos < size && data[pos] != '\n'; ++pos)
+        {
+            if (data[pos] == '\a') return pos + 1;
+            if (data[pos] == escape) return pos + 1 < size && data[pos + 1] == '\\' ? pos + 2 : pos;
+        }
+        return pos;
+    }
+    return data[1] >= 0x20 && data[1] <= 0x7e ? 2 : 1;
+}
+}  // namespace compiler_output_parser_detail
+
+// Whether data holds any ANSI escape sequence
+inline bool HasCompilerOutputEscapes(std::string_view data)
+{
+    return compiler_output_parser_detail::FindEscape(data.data(), data.size()) != data.size();
+}
+
+/*
+ * Removes the ANSI escape sequences of colored compiler output from data by moving the rest to the front, returns the
+ * new size. data can be a line or many of them: newlines are kept. Nothing is written when there is no ESC.
+ */
+inline size_t StripCompilerOutputEscapes(char* data, size_t size)
+{
+    using namespace compiler_output_parser_detail;
+    size_t read = FindEscape(data, size);
+    size_t write = read;
+    while (read < size)
+    {
+        read += EscapeSequenceLength(data + read, size - read);
+        const size_t next = read + FindEscape(data + read, size - read);
+        memmove(data + write, data + read, next - read);
+        write += next - read;
+        read = next;
+    }
+    return write;
+}
+
+// line itself when it holds no escape sequence, otherwise line without them in scratch
+inline std::string_view StripCompilerOutputEscapes(std::string_view line, std::string& scratch)
+{
+    if (!HasCompilerOutputEscapes(line)) return line;
+    scratch.assign(line);
+    scratch.resize(StripCompilerOutputEscapes(scratch.data(), scratch.size()));
+    return scratch;
+}
+
+// File names stored once each, referred to by id
+class CompilerOutputFileTable
+{
+public:
+    static constexpr uint32_t noFile = UINT32_MAX;
+
+    CompilerOutputFileTable() = default;
+    CompilerOutputFileTable(const CompilerOutputFileTable&) = delete;
+    CompilerOutputFileTable& operator=(const CompilerOutputFileTable&) = delete;
+    CompilerOutputFileTable(CompilerOutputFileTable&&) = default;
+    CompilerOutputFileTable& operator=(CompilerOutputFileTable&&) = default;
+
+    // noFile for an empty name
+    uint32_t Intern(std::string_view fileName)
+    {
+        if (fileName.empty()) return noFile;
+        auto it = m_ids.find(fileName);
+        if (it != m_ids.end()) return it->second;
+        // Elements of a deque do not move, the keys can point into them
+        const uint32_t id = static_cast<uint32_t>(m_names.size());
+        m_ids.emplace(m_names.emplace_back(fileName), id);
+        return id;
+    }
+
+    std::string_view Name(uint32_t id) const { return id == noFile ? std::string_view() : std::string_view(m_names[id]); }
+    size_t Size() const { return m_names.size(); }
+
+private:
+    std::deque<std::string> m_names;
+    std::unordered_map<std::string_view, uint32_t> m_ids;
+};
+
+/*
+ * Diagnostics of a whole buffer, one column per field. Messages are kept as offset and length into the parsed buffer,
+ * file names as ids into the file table.
+ */
+struct CompilerOutputBatch
+{
+    std::vector<CompilerOutputLineType> types;
+    std::vector<CompilerOutputRule> rules;
+    std::vector<uint32_t> fileIds;
+    std::vector<uint32_t> lines;
+    std::vector<uint32_t> columns;
+    std::vector<uint64_t> messageOffsets;
+    std::vector<uint32_t> messageLengths;
+    CompilerOutputFileTable files;
+
+    size_t Size() const { return types.size(); }
+
+    // view points into buffer
+    void Append(const CompilerOutputLineView& view, std::string_view buffer)
+    {
+        types.push_back(view.type);
+        rules.push_back(view.rule);
+        fileIds.push_back(files.Intern(view.fileName));
+        lines.push_back(view.line);
+        columns.push_back(view.column);
+        messageOffsets.push_back(view.message.empty() ? 0 : static_cast<uint64_t>(view.message.data() - buffer.data()));
+        messageLengths.push_back(static_cast<uint32_t>(view.message.size()));
+    }
+
+    // The entry as a view, buffer being the parsed buffer
+    CompilerOutputLineView View(size_t index, std::string_view buffer) const
+    {
+        return {.type = types[index],
+                .rule = rules[index],
+                .line = lines[index],
+                .column = columns[index],
+                .fileName = files.Name(fileIds[index]),
+                .message = buffer.substr(messageOffsets[index], messageLengths[index])};
+    }
+};
+
+namespace compiler_output_parser_detail
+{
+inline std::string_view TrimBlanks(std::string_view text)
+{
+    while (!text.empty() && IsBlank(text.front())) text.remove_prefix(1);
+    while (!text.empty() && IsBlank(text.back())) text.remove_suffix(1);
+    return text;
+}
+
+// Messages compare equal when they only differ by blanks around them or by the length of blank runs
+inline bool NormalizedMessageEqual(std::string_view lhs, std::string_view rhs)
+{
+    lhs = TrimBlanks(lhs);
+    rhs = TrimBlanks(rhs);
+    size_t i = 0;
+    size_t j = 0;
+    while (i < lhs.size() && j < rhs.size())
+    {
+        const bool blank = IsBlank(lhs[i]);
+        if (blank != IsBlank(rhs[j])) return false;
+        if (blank)
+        {
+            while (i < lhs.size() && IsBlank(lhs[i])) ++i;
+            while (j < rhs.size() && IsBlank(rhs[j])) ++j;
+            continue;
+        }
+        if (lhs[i++] != rhs[j++]) return false;
+    }
+    return i == lhs.size() && j == rhs.size();
+}
+
+// FNV-1a
+constexpr uint64_t hashSeed = 14695981039346656037ull;
+constexpr uint64_t HashByte(uint64_t hash, unsigned char byte) { return (hash ^ byte) * 1099511628211ull; }
+
+inline uint64_t HashBytes(uint64_t hash, std::string_view bytes)
+{
+    for (char c : bytes) hash = HashByte(hash, static_cast<unsigned char>(c));
+    return hash;
+}
+
+// Hash of the message as NormalizedMessageEqual sees it
+inline uint64_t HashNormalizedMessage(uint64_t hash, std::string_view message)
+{
+    message = TrimBlanks(message);
+    for (size_t i = 0; i < message.size(); ++i)
+    {
+        if (IsBlank(message[i]))
+        {
+            while (IsBlank(message[i + 1])) ++i;
+            hash = HashByte(hash, ' ');
+        }
+        else
+        {
+            hash = HashByte(hash, static_cast<unsigned char>(message[i]));
+        }
+    }
+    return hash;
+}
+}  // namespace compiler_output_parser_detail
+
+// A diagnostic seen count times, the line numbers being those of the log
+struct CompilerOutputUniqueLine
+{
+    CompilerOutputLineView view;
+    uint64_t count{0};
+    uint64_t firstLine{0};
+    uint64_t lastLine{0};
+};
+
+/*
+ * Collapses repeated diagnostics, e.g. a warning of a header reported once per translation unit. Diagnostics are the
+ * same when their rule, file, line, column and message match, blank runs in the message being compared as one blank.
+ * The table is open addressing with linear probing, each slot holding a 32 bit hash tag and the index of the line.
+ * The views are kept as they are added and have to outlive the deduplicator.
+ */
+class CompilerOutputDeduplicator
+{
+public:
+    // Returns true the first time the diagnostic is seen
+    bool Add(const CompilerOutputLineView& view, uint64_t logLine) { return Insert(view, 1, logLine, logLine); }
+
+    // Adds the lines of other, whose line numbers are lineOffset behind those of this one
+    void Merge(const CompilerOutputDeduplicator& other, uint64_t lineOffset)
+    {
+        for (const CompilerOutputUniqueLine& line : other.m_lines)
+        {
+            Insert(line.view, line.count, line.firstLine + lineOffset, line.lastLine + lineOffset);
+        }
+    }
+
+    // In the order they were first seen
+    const std::vector<CompilerOutputUniqueLine>& Lines() const { return m_lines; }
+    size_t Size() const { return m_lines.size(); }
+
+private:
+    struct Slot
+    {
+        uint32_t tag{0};  // 0 for an empty slot
+        uint32_t index{0};
+    };
+
+    static uint64_t Hash(const CompilerOutputLineView& view)
+    {
+        using namespace compiler_output_parser_detail;
+        uint64_t hash = HashByte(hashSeed, static_cast<unsigned char>(view.rule));
+        hash = HashBytes(hash, std::string_view(reinterpret_cast<const char*>(&view.runtimeRule), sizeof(view.runtimeRule)));
+        hash = HashBytes(hash, std::string_view(reinterpret_cast<const char*>(&view.line), sizeof(view.line)));
+        hash = HashBytes(hash, std::string_view(reinterpret_cast<const char*>(&view.column), sizeof(view.column)));
+        hash = HashBytes(hash, view.fileName);
+        hash = HashByte(hash, 0);
+        return HashNormalizedMessage(hash, view.message);
+    }
+
+    static uint32_t Tag(uint64_t hash) { return static_cast<uint32_t>(hash >> 32) | 1; }
+
+    static bool Equal(const CompilerOutputLineView& lhs, const CompilerOutputLineView& rhs)
+    {
+        return lhs.rule == rhs.rule && lhs.runtimeRule == rhs.runtimeRule && lhs.line == rhs.line && lhs.column == rhs.column &&
+               lhs.fileName == rhs.fileName && compiler_output_parser_detail::NormalizedMessageEqual(lhs.message, rhs.message);
+    }
+
+    bool Insert(const CompilerOutputLineView& view, uint64_t count, uint64_t firstLine, uint64_t lastLine)
+    {
+        // At most half full
+        if (2 * (m_lines.size() + 1) > m_slots.size()) Grow();
+        const uint64_t hash = Hash(view);
+        const uint32_t tag = Tag(hash);
+        const size_t mask = m_slots.size() - 1;
+        for (size_t slotIndex = hash & mask;; slotIndex = (slotIndex + 1) & mask)
+        {
+            Slot& slot = m_slots[slotIndex];
+            if (slot.tag == 0)
+            {
+                slot = {tag, static_cast<uint32_t>(m_lines.size())};
+                m_lines.push_back({view, count, firstLine, lastLine});
+                m_hashes.push_back(hash);
+                return true;
+            }
+            if (slot.tag == tag && Equal(m_lines[slot.index].view, view))
+            {
+                CompilerOutputUniqueLine& line = m_lines[slot.index];
+                line.count += count;
+                line.firstLine = std::min(line.firstLine, firstLine);
+                line.lastLine = std::max(line.lastLine, lastLine);
+                return false;
+            }
+        }
+    }
+
+    void Grow()
+    {
+        std::vector<Slot> slots(std::max<size_t>(64, 2 * m_slots.size()));
+        const size_t mask = slots.size() - 1;
+        for (uint32_t index = 0; index < m_hashes.size(); ++index)
+        {
+            size_t slotIndex = m_hashes[index] & mask;
+            while (slots[slotIndex].tag != 0) slotIndex = (slotIndex + 1) & mask;
+            slots[slotIndex] = {Tag(m_hashes[index]), index};
+        }
+        m_slots = std::move(slots);
+    }
+
+    std::vector<Slot> m_slots;
+    std::vector<CompilerOutputUniqueLine> m_lines;
+    std::vector<uint64_t> m_hashes;
+};
+
+/*
+ * Fingerprints of diagnostics, to find those of a log that another one does not have. The fingerprint hashes what the
+ * deduplicator compares, with the file name taken without the build directory prefixes given, so that builds in
+ * different directories match. Only the 64 bit fingerprints are kept, in an open addressing table at most half full:
+ * the logs do not have to stay in memory, and two different diagnostics share a fingerprint with a chance of 2^-64.
+ */
+class CompilerOutputFingerprintSet
+{
+public:
+    // File names starting with prefix, as a whole directory, are fingerprinted from the rest of the path. An empty prefix is ignored
+    void AddPathPrefix(std::string_view prefix)
+    {
+        if (prefix.empty()) return;
+        while (prefix.size() > 1 && prefix.back() == '/') prefix.remove_suffix(1);
+        m_prefixes.emplace_back(prefix);
+    }
+
+    uint64_t Fingerprint(const CompilerOutputLineView& view) const
+    {
+        using namespace compiler_output_parser_detail;
+        uint64_t hash = HashByte(hashSeed, static_cast<unsigned char>(view.rule));
+        hash = HashBytes(hash, std::string_view(reinterpret_cast<const char*>(&view.runtimeRule), sizeof(view.runtimeRule)));
+        hash = HashBytes(hash, std::string_view(reinterpret_cast<const char*>(&view.line), sizeof(view.line)));
+        hash = HashBytes(hash, std::string_view(reinterpret_cast<const char*>(&view.column), sizeof(view.column)));
+        hash = HashBytes(hash, NormalizedPath(view.fileName));
+        hash = HashByte(hash, 0);
+        // 0 marks an empty slot
+        return HashNormalizedMessage(hash, view.message) | 1;
+    }
+
+    // Returns true when the fingerprint was not in the set
+    bool Insert(uint64_t fingerprint)
+    {
+        if (2 * (m_size + 1) > m_slots.size()) Grow();
+        uint64_t& slot = m_slots[Find(m_slots, fingerprint)];
+        if (slot == fingerprint) return false;
+        slot = fingerprint;
+        ++m_size;
+        return true;
+    }
+
+    bool Contains(uint64_t fingerprint) const { return !m_slots.empty() && m_slots[Find(m_slots, fingerprint)] == fingerprint; }
+
+    size_t Size() const { return m_size; }
+
+private:
+    // The slot holding fingerprint, or the empty one where it would go
+    static size_t Find(const std::vector<uint64_t>& slots, uint64_t fingerprint)
+    {
+        const size_t mask = slots.size() - 1;
+        size_t slotIndex = fingerprint & mask;
+        while (slots[slotIndex] != 0 && slots[slotIndex] != fingerprint) slotIndex = (slotIndex + 1) & mask;
+        return slotIndex;
+    }
+
+    void Grow()
+    {
+        std::vector<uint64_t> slots(std::max<size_t>(64, 2 * m_slots.size()));
+        for (uint64_t fingerprint : m_slots)
+        {
+            if (fingerprint != 0) slots[Find(slots, fingerprint)] = fingerprint;
+        }
+        m_slots = std::move(slots);
+    }
+
+    // Without the longest matching prefix and without a leading ./
+    std::string_view NormalizedPath(std::string_view fileName) const
+    {
+        size_t prefixSize = 0;
+        for (const std::string& prefix : m_prefixes)
+        {
+            // The / after the prefix goes with it
+            const size_t size = prefix.back() == '/' ? prefix.size() : prefix.size() + 1;
+            if (size > prefixSize && fileName.size() >= size && fileName.starts_with(prefix) && fileName[size - 1] == '/') prefixSize = size;
+        }
+        fileName.remove_prefix(prefixSize);
+        while (fileName.starts_with("./")) fileName.remove_prefix(2);
+        return fileName;
+    }
+
+    std::vector<uint64_t> m_slots;
+    size_t m_size{0};
+    std::vector<std::string> m_prefixes;
+};
+
+// Diagnostics of one source file by type
+struct CompilerOutputFileCounts
+{
+    uint64_t errors{0};
+    uint64_t warnings{0};
+    uint64_t infos{0};
+
+    uint64_t Total() const { return errors + warnings + infos; }
+};
+
+/*
+ * Diagnostic counts by type, by rule, by source file and by warning, for summaries over many logs. Only the counts are
+ * kept, along with a copy of each file name and warning, so a log can be released once it is parsed. Warnings are
+ * counted by the option GCC ends their message with ([-Wunused-variable]), or by their message when there is none.
+ * Summaries filled on different threads are added up with Merge().
+ */
+class CompilerOutputSummary
+{
+public:
+    template <typename Count>
+    using Ranking = std::vector<std::pair<std::string_view, Count>>;
+
+    void Add(const CompilerOutputLineView& view)
+    {
+        ++m_types[static_cast<size_t>(view.type)];
+        ++m_rules[static_cast<size_t>(view.rule)];
+        if (!view.fileName.empty())
+        {
+            CompilerOutputFileCounts& counts = Find(m_files, view.fileName);
+            if (view.type == CompilerOutputLineType::error) ++counts.errors;
+            else if (view.type == CompilerOutputLineType::warning) ++counts.warnings;
+            else if (view.type == CompilerOutputLineType::info) ++counts.infos;
+        }
+        if (view.type == CompilerOutputLineType::warning) ++Find(m_warnings, WarningKey(view.message));
+    }
+
+    void Merge(const CompilerOutputSummary& other)
+    {
+        for (size_t type = 0; type < m_types.size(); ++type) m_types[type] += other.m_types[type];
+        for (size_t rule = 0; rule < m_rules.size(); ++rule) m_rules[rule] += other.m_rules[rule];
+        for (const auto& [fileName, otherCounts] : other.m_files)
+        {
+            CompilerOutputFileCounts& counts = Find(m_files, fileName);
+            counts.errors += otherCounts.errors;
+            counts.warnings += otherCounts.warnings;
+            counts.infos += otherCounts.infos;
+        }
+        for (const auto& [warning, count] : other.m_warnings) Find(m_warnings, warning) += count;
+    }
+
+    uint64_t Count(CompilerOutputLineType type) const { return m_types[static_cast<size_t>(type)]; }
+    uint64_t Count(CompilerOutputRule rule) const { return m_rules[static_cast<size_t>(rule)]; }
+    size_t FileCount() const { return m_files.size(); }
+
+    // The n files with the most diagnostics, most first
+    Ranking<CompilerOutputFileCounts> TopFiles(size_t n) const
+    {
+        return Top<CompilerOutputFileCounts>(m_files, n, [](const CompilerOutputFileCounts& counts) { return counts.Total(); });
+    }
+
+    // The n most frequent warnings, most first
+    Ranking<uint64_t> TopWarnings(size_t n) const
+    {
+        return Top<uint64_t>(m_warnings, n, [](uint64_t count) { return count; });
+    }
+
+private:
+    // Lookups by string_view, a string is only made for a name seen for the first time
+    struct NameHash
+    {
+        using is_transparent = void;
+        size_t operator()(std::string_view name) const { return std::hash<std::string_view>()(name); }
+    };
+
+    template <typename Count>
+    using NameMap = std::unordered_map<std::string, Count, NameHash, std::equal_to<>>;
+
+    template <typename Count>
+    static Count& Find(NameMap<Count>& map, std::string_view name)
+    {
+        auto it = map.find(name);
+        if (it == map.end()) it = map.emplace(name, Count()).first;
+        return it->second;
+    }
+
+    static std::string_view WarningKey(std::string_view message)
+    {
+        message = compiler_output_parser_detail::TrimBlanks(message);
+        const size_t option = message.rfind("[-W");
+        return option != std::string_view::npos && message.back() == ']' ? message.substr(option) : message;
+    }
+
+    template <typename Count, typename Total>
+    static Ranking<Count> Top(const NameMap<Count>& map, size_t n, Total&& total)
+    {
+        Ranking<Count> ranking(map.begin(), map.end());
+        auto more = [&total](const auto& lhs, const auto& rhs)
+        { return total(lhs.second) != total(rhs.second) ? total(lhs.second) > total(rhs.second) : lhs.first < rhs.first; };
+        n = std::min(n, ranking.size());
+        std::partial_sort(ranking.begin(), ranking.begin() + static_cast<std::ptrdiff_t>(n), ranking.end(), more);
+        ranking.resize(n);
+        return ranking;
+    }
+
+    std::array<uint64_t, 4> m_types{};
+    std::array<uint64_t, compilerOutputRuleCount> m_rules{};
+    NameMap<CompilerOutputFileCounts> m_files;
+    NameMap<uint64_t> m_warnings;
+};
+
+// A line of a diagnostic group, with the source and caret lines quoted under it
+struct CompilerOutputDiagnostic
+{
+    CompilerOutputLineType type{CompilerOutputLineType::normal};
+    CompilerOutputRule rule{CompilerOutputRule::none};
+    uint16_t runtimeRule{CompilerOutputLineView::noRuntimeRule};
+    std::string fileName;
+    uint32_t line{CompilerOutputLineView::noNumber};
+    uint32_t column{CompilerOutputLineView::noNumber};
+    std::string message;
+    std::vector<std::string> quotedLines;
+
+    // Points into this diagnostic
+    CompilerOutputLineView View() const
+    {
+        return {.type = type, .rule = rule, .runtimeRule = runtimeRule, .line = line, .column = column, .fileName = fileName, .message = message};
+    }
+};
+
+/*
+ * A diagnostic with the lines GCC prints around it: the include chain and the "In function", "In instantiation of" and
+ * "required from" context before it, and the notes after it. primary is normal when the group ended before one came.
+ */
+struct CompilerOutputDiagnosticGroup
+{
+    std::vector<std::string> includedFrom;
+    std::vector<CompilerOutputDiagnostic> context;
+    CompilerOutputDiagnostic primary;
+    std::vector<CompilerOutputDiagnostic> notes;
+
+    bool Empty() const { return includedFrom.empty() && context.empty() && primary.type == CompilerOutputLineType::normal && notes.empty(); }
+};
+
+/*
+ * Builds diagnostic groups from the lines of a log in one pass. Each line is looked at once, by its rule or, for lines no
+ * rule matches, by how it starts, and a group is complete as soon as a line arrives that cannot belong to it.
+ */
+class CompilerOutputGrouper
+{
+public:
+    /*
+     * Adds the next line of the log and its parse result. Returns true when the line completed the group before it,
+     * which is then moved to completed.
+     */
+    bool Add(std::string_view line, const CompilerOutputLineView& view, CompilerOutputDiagnosticGroup& completed)
+    {
+        bool done = false;
+        switch (Classify(line, view))
+        {
+            case LineKind::includedFrom:
+                done = Complete(completed);
+                m_group.includedFrom.emplace_back(line);
+                m_last = Last::none;
+                break;
+            case LineKind::includedFromContinuation:
+                if (m_group.includedFrom.empty() || m_last != Last::none) return Complete(completed);
+                m_group.includedFrom.emplace_back(line);
+                break;
+            case LineKind::context:
+                if (m_group.primary.type != CompilerOutputLineType::normal || !m_group.notes.empty()) done = Complete(completed);
+                m_group.context.push_back(MakeDiagnostic(view));
+                m_last = Last::context;
+                break;
+            case LineKind::primary:
+                if (m_group.primary.type != CompilerOutputLineType::normal || !m_group.notes.empty()) done = Complete(completed);
+                m_group.primary = MakeDiagnostic(view);
+                m_last = Last::primary;
+                break;
+            case LineKind::note:
+                m_group.notes.push_back(MakeDiagnostic(view));
+                m_last = Last::note;
+                break;
+            case LineKind::quoted:
+                if (m_last == Last::none) return Complete(completed);
+                LastDiagnostic().quotedLines.emplace_back(line);
+                break;
+            case LineKind::unrelated:
+                return Complete(completed);
+        }
+        return done;
+    }
+
+    // Completes the last group at the end of the log
+    bool Finish(CompilerOutputDiagnosticGroup& completed) { return Complete(completed); }
+
+private:
+    enum class LineKind
+    {
+        includedFrom,              // In file included from a.h:3,
+        includedFromContinuation,  //                  from a.cpp:1:
+        context,                   // In function, In instantiation of, required from, ...
+        primary,
+        note,
+        quoted,  // source and caret lines, "   10 |   x = 1;" and "      |   ^"
+        unrelated
+    };
+
+    enum class Last
+    {
+        none,
+        context,
+        primary,
+        note
+    };
+
+    static LineKind Classify(std::string_view line, const CompilerOutputLineView& view)
+    {
+        switch (view.rule)
+        {
+            case CompilerOutputRule::none:
+                // A rule loaded at run time with no built-in name
+                if (view.type != CompilerOutputLineType::normal) return LineKind::primary;
+                break;
+            case CompilerOutputRule::inFunctionInfo:
+            case CompilerOutputRule::inInstantiationWarning:
+            case CompilerOutputRule::requiredFromWarning:
+            case CompilerOutputRule::instantiatedFromInfo:
+            case CompilerOutputRule::instantiatedFromInfo2:
+            case CompilerOutputRule::skippingInstantiationContextsInfo:
+            case CompilerOutputRule::skippingInstantiationContextsInfo2:
+                return LineKind::context;
+            case CompilerOutputRule::compilerNote:
+            case CompilerOutputRule::compilerNote2:
+            case CompilerOutputRule::generalNote:
+                return LineKind::note;
+            default:
+                return LineKind::primary;
+        }
+        if (line.starts_with("In file included from ")) return LineKind::includedFrom;
+        const size_t indent = line.find_first_not_of(" \t");
+        if (indent == std::string_view::npos) return LineKind::unrelated;
+        if (indent > 0 && line.substr(indent).starts_with("from ")) return LineKind::includedFromContinuation;
+        // [blanks][line number][blanks]|
+        size_t pos = indent;
+        while (pos < line.size() && compiler_output_parser_detail::IsDigit(line[pos])) ++pos;
+        while (pos < line.size() && compiler_output_parser_detail::IsBlank(line[pos])) ++pos;
+        return pos < line.size() && line[pos] == '|' ? LineKind::quoted : LineKind::unrelated;
+    }
+
+    static CompilerOutputDiagnostic MakeDiagnostic(const CompilerOutputLineView& view)
+    {
+        return {.type = view.type,
+                .rule = view.rule,
+                .runtimeRule = view.runtimeRule,
+                .fileName = std::string(view.fileName),
+                .line = view.line,
+                .column = view.column,
+                .message = std::string(view.message),
+                .quotedLines = {}};
+    }
+
+    CompilerOutputDiagnostic& LastDiagnostic()
+    {
+        switch (m_last)
+        {
+            case Last::context:
+                return m_group.context.back();
+            case Last::note:
+                return m_group.notes.back();
+            default:
+                return m_group.primary;
+        }
+    }
+
+    bool Complete(CompilerOutputDiagnosticGroup& completed)
+    {
+        m_last = Last::none;
+        if (m_group.Empty()) return false;
+        completed = std::move(m_group);
+        m_group = {};
+        return true;
+    }
+
+    CompilerOutputDiagnosticGroup m_group;
+    Last m_last{Last::none};
+};
+
+#endif  // COMPILER_OUTPUT_TYPES_HPP_INCLUDED
@@ -0,0 +1,371 @@
+/*
+ * Compiler Output Parser: Parse error, warning and messages
+ * Copyright (C) 2024  Christo Joseph
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMPRESSED_LOG_HPP_INCLUDED
+#define COMPRESSED_LOG_HPP_INCLUDED
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "compiler_output_parser.hpp"
+
+// Built with -DLOG_PARSER_WITH_ZLIB and -DLOG_PARSER_WITH_ZSTD when the libraries are there
+#ifdef LOG_PARSER_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef LOG_PARSER_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+enum class LogCompression
+{
+    none,
+    gzip,
+    zstd
+};
+
+// From the magic number at the start of data
+inline LogCompression DetectLogCompression(std::string_view data)
+{
+    if (data.starts_with("\x1f\x8b")) return LogCompression::gzip;
+    if (data.starts_with("\x28\xb5\x2f\xfd")) return LogCompression::zstd;
+    return LogCompression::none;
+}
+
+// From the first bytes of the file at path, none for "-" whose bytes cannot be looked at without consuming them
+inline LogCompression DetectLogCompression(const char* path)
+{
+    if (std::string_view(path) == "-") return LogCompression::none;
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return LogCompression::none;
+    char magic[4];
+    const ssize_t count = pread(fd, magic, sizeof(magic), 0);
+    close(fd);
+    return count > 0 ? DetectLogCompression(std::string_view(magic, static_cast<size_t>(count))) : LogCompression::none;
+}
+
+constexpr const char* GetLogCompressionName(LogCompression compression)
+{
+    switch (compression)
+    {
+        case LogCompression::gzip:
+            return "gzip";
+        case LogCompression::zstd:
+            return "zstd";
+        default:
+            return "none";
+    }
+}
+
+constexpr bool IsLogCompressionSupported(LogCompression compression)
+{
+    switch (compression)
+    {
+        case LogCompression::gzip:
+#ifdef LOG_PARSER_WITH_ZLIB
+            return true;
+#else
+            return false;
+#endif
+        case LogCompression::zstd:
+#ifdef LOG_PARSER_WITH_ZSTD
+            return true;
+#else
+            return false;
+#endif
+        default:
+            return true;
+    }
+}
+
+/*
+ * A compressed log, decompressed on a thread of its own while the lines of the block before are parsed. Blocks only
+ * hold whole lines: the partial line at the end of a block is moved to the start of the next one, and a block grows
+ * when a single line does not fit. At most three blocks are in memory, the one read, a finished one and the one being
+ * filled, unless KeepBlocks() was called.
+ */
+class CompressedLogStream
+{
+public:
+    static constexpr size_t defaultBlockSize = 32 << 20;
+
+    // data is the whole compressed log, it must outlive the stream
+    CompressedLogStream(std::string_view data, LogCompression compression, size_t blockSize = defaultBlockSize)
+        : m_blockSize(blockSize), m_thread(&CompressedLogStream::Decompress, this, data, compression)
+    {
+    }
+    CompressedLogStream(const CompressedLogStream&) = delete;
+    CompressedLogStream& operator=(const CompressedLogStream&) = delete;
+    ~CompressedLogStream()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_changed.notify_all();
+        m_thread.join();
+    }
+
+    // The views of earlier blocks stay valid until the stream is destroyed instead of until the next ReadBlock
+    void KeepBlocks() { m_keepBlocks = true; }
+
+    // Waits for the next block of lines, returns false at the end of the log or on an error reported by Error()
+    bool ReadBlock(std::string_view& lines)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_reading.size)
+        {
+            (m_keepBlocks ? m_kept : m_free).push_back(std::move(m_reading));
+            m_reading = {};
+        }
+        m_changed.wait(lock, [this] { return !m_ready.empty() || m_done; });
+        if (m_ready.empty()) return false;
+        m_reading = std::move(m_ready.front());
+        m_ready.pop_front();
+        m_changed.notify_all();
+        lines = std::string_view(m_reading.data.data(), m_reading.size);
+        return true;
+    }
+
+    // Same as LogStream::ReadLines, a call goes through one block
+    template <typename OnLine>
+    bool ReadLines(OnLine&& onLine)
+    {
+        std::string_view lines;
+        if (!ReadBlock(lines)) return false;
+        ForEachCompilerOutputLine(lines, onLine);
+        return true;
+    }
+
+    // errno value, EBADMSG for corrupt or truncated data
+    // Also read after an early stop, while the decoder thread may still set it
+    int Error() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_error;
+    }
+
+private:
+    enum class DecodeResult
+    {
+        more,
+        end,
+        error
+    };
+
+    struct Block
+    {
+        std::vector<char> data;
+        size_t size{0};
+    };
+
+#ifdef LOG_PARSER_WITH_ZLIB
+    // Concatenated gzip members, as written by gzip -c a >> log, are read one after the other
+    class GzipDecoder
+    {
+    public:
+        explicit GzipDecoder(std::string_view input) : m_input(input) { m_initialized = inflateInit2(&m_stream, MAX_WBITS + 16) == Z_OK; }
+        GzipDecoder(const GzipDecoder&) = delete;
+        GzipDecoder& operator=(const GzipDecoder&) = delete;
+        ~GzipDecoder()
+        {
+            if (m_initialized) inflateEnd(&m_stream);
+        }
+
+        DecodeResult operator()(char* output, size_t size, size_t& produced)
+        {
+            if (!m_initialized) return DecodeResult::error;
+            if (m_stream.avail_in == 0 && m_offset < m_input.size())
+            {
+                const size_t inputSize = std::min(m_input.size() - m_offset, maxPieceSize);
+                m_stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(m_input.data() + m_offset));
+                m_stream.avail_in = static_cast<uInt>(inputSize);
+                m_offset += inputSize;
+            }
+            const size_t outputSize = std::min(size, maxPieceSize);
+            m_stream.next_out = reinterpret_cast<Bytef*>(output);
+            m_stream.avail_out = static_cast<uInt>(outputSize);
+            const int status = inflate(&m_stream, Z_NO_FLUSH);
+            produced = outputSize - m_stream.avail_out;
+            if (status == Z_OK) return DecodeResult::more;
+            if (status != Z_STREAM_END) return DecodeResult::error;
+            if (m_stream.avail_in == 0 && m_offset == m_input.size()) return DecodeResult::end;
+            return inflateReset(&m_stream) == Z_OK ? DecodeResult::more : DecodeResult::error;
+        }
+
+    private:
+        // uInt sized
+        static constexpr size_t maxPieceSize = 1 << 30;
+
+        std::string_view m_input;
+        size_t m_offset{0};
+        z_stream m_stream{};
+        bool m_initialized{false};
+    };
+#endif
+
+#ifdef LOG_PARSER_WITH_ZSTD
+    // Frames follow each other in the same stream
+    class ZstdDecoder
+    {
+    public:
+        explicit ZstdDecoder(std::string_view input) : m_stream(ZSTD_createDStream()), m_input{input.data(), input.size(), 0}
+        {
+            if (m_stream) ZSTD_initDStream(m_stream);
+        }
+        ZstdDecoder(const ZstdDecoder&) = delete;
+        ZstdDecoder& operator=(const ZstdDecoder&) = delete;
+        ~ZstdDecoder() { ZSTD_freeDStream(m_stream); }
+
+        DecodeResult operator()(char* output, size_t size, size_t& produced)
+        {
+            if (!m_stream) return DecodeResult::error;
+            ZSTD_outBuffer outputBuffer{output, size, 0};
+            const size_t status = ZSTD_decompressStream(m_stream, &outputBuffer, &m_input);
+            produced = outputBuffer.pos;
+            if (ZSTD_isError(status)) return DecodeResult::error;
+            // Everything decoded is out once there is room left, a frame still open then is a truncated one
+            if (m_input.pos < m_input.size || outputBuffer.pos == outputBuffer.size) return DecodeResult::more;
+            return status == 0 ? DecodeResult::end : DecodeResult::error;
+        }
+
+    private:
+        ZSTD_DStream* m_stream;
+        ZSTD_inBuffer m_input;
+    };
+#endif
+
+    void Decompress([[maybe_unused]] std::string_view data, LogCompression compression)
+    {
+        switch (compression)
+        {
+#ifdef LOG_PARSER_WITH_ZLIB
+            case LogCompression::gzip:
+            {
+                GzipDecoder decoder(data);
+                Produce(decoder);
+                return;
+            }
+#endif
+#ifdef LOG_PARSER_WITH_ZSTD
+            case LogCompression::zstd:
+            {
+                ZstdDecoder decoder(data);
+                Produce(decoder);
+                return;
+            }
+#endif
+            default:
+                Finish({}, ENOTSUP);
+                return;
+        }
+    }
+
+    template <typename Decoder>
+    void Produce(Decoder& decoder)
+    {
+        Block block = NextFreeBlock();
+        for (;;)
+        {
+            if (block.size == block.data.size() && !HandOff(block)) return;
+            size_t produced = 0;
+            const DecodeResult result = decoder(block.data.data() + block.size, block.data.size() - block.size, produced);
+            block.size += produced;
+            if (result != DecodeResult::more)
+            {
+                Finish(std::move(block), result == DecodeResult::error ? EBADMSG : 0);
+                return;
+            }
+        }
+    }
+
+    Block NextFreeBlock()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Block block;
+        if (!m_free.empty())
+        {
+            block = std::move(m_free.front());
+            m_free.pop_front();
+        }
+        block.data.resize(std::max(block.data.size(), m_blockSize));
+        block.size = 0;
+        return block;
+    }
+
+    // Passes on the whole lines of a full block and starts the next one with the rest, returns false when the reader is gone
+    bool HandOff(Block& block)
+    {
+        const std::string_view filled(block.data.data(), block.size);
+        const size_t lastNewline = filled.rfind('\n');
+        if (lastNewline == std::string_view::npos)
+        {
+            block.data.resize(block.data.size() * 2);
+            return true;
+        }
+        m_carry.assign(filled.begin() + lastNewline + 1, filled.end());
+        block.size = lastNewline + 1;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_changed.wait(lock, [this] { return m_ready.empty() || m_stop; });
+            if (m_stop) return false;
+            m_ready.push_back(std::move(block));
+        }
+        m_changed.notify_all();
+        block = NextFreeBlock();
+        if (block.data.size() < m_carry.size() * 2) block.data.resize(m_carry.size() * 2);
+        std::copy(m_carry.begin(), m_carry.end(), block.data.begin());
+        block.size = m_carry.size();
+        return true;
+    }
+
+    void Finish(Block block, int error)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (block.size) m_ready.push_back(std::move(block));
+            m_error = error;
+            m_done = true;
+        }
+        m_changed.notify_all();
+    }
+
+    const size_t m_blockSize;
+    bool m_keepBlocks{false};
+    mutable std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::deque<Block> m_ready;
+    std::deque<Block> m_free;
+    std::deque<Block> m_kept;
+    Block m_reading;
+    std::vector<char> m_carry;
+    bool m_stop{false};
+    bool m_done{false};
+    int m_error{0};
+    // Last, it starts running once everything else is constructed
+    std::thread m_thread;
+};
+
+#endif  // COMPRESSED_LOG_HPP_INCLUDED
@@ -0,0 +1,392 @@
+/*
+ * Compiler Output Parser: Parse error, warning and messages
+ * Copyright (C) 2024  Christo Joseph
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DIAGNOSTIC_WRITER_HPP_INCLUDED
+#define DIAGNOSTIC_WRITER_HPP_INCLUDED
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "compiler_output_parser.hpp"
+
+// Output going to a FILE in large writes
+class OutputBuffer
+{
+public:
+    static constexpr size_t defaultCapacity = 1 << 20;
+
+    explicit OutputBuffer(FILE* file, size_t capacity = defaultCapacity) : m_file(file) { m_data.reserve(capacity); }
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+    ~OutputBuffer() { Flush(); }
+
+    void Append(std::string_view text)
+    {
+        if (m_data.size() + text.size() > m_data.capacity())
+        {
+            Flush();
+            // Larger than the whole buffer, written as it is
+            if (text.size() > m_data.capacity())
+            {
+                fwrite(text.data(), 1, text.size(), m_file);
+                return;
+            }
+        }
+        m_data.insert(m_data.end(), text.begin(), text.end());
+    }
+
+    void Append(char c)
+    {
+        if (m_data.size() == m_data.capacity()) Flush();
+        m_data.push_back(c);
+    }
+
+    void AppendNumber(uint64_t number)
+    {
+        char digits[20];
+        char* begin = digits + sizeof(digits);
+        do
+        {
+            *--begin = static_cast<char>('0' + number % 10);
+            number /= 10;
+        } while (number);
+        Append(std::string_view(begin, static_cast<size_t>(digits + sizeof(digits) - begin)));
+    }
+
+    // text as the contents of a JSON string, runs that need no escape are copied as they are
+    void AppendJsonString(std::string_view text)
+    {
+        size_t runBegin = 0;
+        for (size_t pos = 0; pos < text.size(); ++pos)
+        {
+            const unsigned char c = static_cast<unsigned char>(text[pos]);
+            if (!jsonEscapes[c]) continue;
+            Append(text.substr(runBegin, pos - runBegin));
+            AppendJsonEscape(c);
+            runBegin = pos + 1;
+        }
+        Append(text.substr(runBegin));
+    }
+
+    void Flush()
+    {
+        if (m_data.empty()) return;
+        fwrite(m_data.data(), 1, m_data.size(), m_file);
+        m_data.clear();
+        fflush(m_file);
+    }
+
+private:
+    // The characters JSON strings cannot hold as they are
+    static constexpr std::array<bool, 256> jsonEscapes = []
+    {
+        std::array<bool, 256> escapes{};
+        for (unsigned c = 0; c < 0x20; ++c) escapes[c] = true;
+        escapes['"'] = escapes['\\'] = escapes[0x7f] = true;
+        return escapes;
+    }();
+
+    void AppendJsonEscape(unsigned char c)
+    {
+        switch (c)
+        {
+            case '"':
+                Append("\\\"");
+                break;
+            case '\\':
+                Append("\\\\");
+                break;
+            case '\n':
+                Append("\\n");
+                break;
+            case '\r':
+                Append("\\r");
+                break;
+            case '\t':
+                Append("\\t");
+                break;
+            default:
+            {
+                const char escape[] = {'\\', 'u', '0', '0', "0123456789abcdef"[c >> 4], "0123456789abcdef"[c & 15]};
+                Append(std::string_view(escape, sizeof(escape)));
+                break;
+            }
+        }
+    }
+
+    FILE* m_file;
+    std::vector<char> m_data;
+};
+
+enum class OutputFormat
+{
+    text,
+    jsonLines,
+    sarif
+};
+
+// What is known about a diagnostic besides its view, zero when unknown
+struct DiagnosticDetails
+{
+    uint64_t logLine{0};
+    uint64_t count{0};
+    uint64_t firstLogLine{0};
+    uint64_t lastLogLine{0};
+};
+
+/*
+ * Writes diagnostics as text lines, JSON Lines (one object per diagnostic) or a SARIF 2.1.0 log with one run whose
+ * rules are those of DefaultCompilerOutputRuleSet, or the rules loaded at run time once SetRuntimeRuleNames() is called.
+ * Begin() and End() write what comes before and after the diagnostics.
+ */
+class DiagnosticWriter
+{
+public:
+    DiagnosticWriter(OutputFormat format, FILE* file) : m_format(format), m_buffer(file) {}
+
+    // Names of the rules of a CompilerOutputRuntimeParser in their order, the views report them by runtimeRule. Before Begin()
+    void SetRuntimeRuleNames(std::vector<std::string> names) { m_runtimeRuleNames = std::move(names); }
+
+    void Begin()
+    {
+        if (m_format != OutputFormat::sarif) return;
+        m_buffer.Append("{\"version\":\"2.1.0\",\"$schema\":\"https://json.schemastore.org/sarif-2.1.0.json\",\"runs\":[{\"tool\":{\"driver\":{"
+                        "\"name\":\"log-parser\",\"informationUri\":\"https://github.com/josephch/compiler-output-parser\",\"rules\":[");
+        if (m_runtimeRuleNames.empty())
+        {
+            for (size_t rule = 1; rule < compilerOutputRuleCount; ++rule)
+            {
+                m_buffer.Append(rule == 1 ? "{\"id\":\"" : ",{\"id\":\"");
+                m_buffer.Append(GetCompilerOutputRuleName(static_cast<CompilerOutputRule>(rule)));
+                m_buffer.Append("\"}");
+            }
+        }
+        for (size_t rule = 0; rule < m_runtimeRuleNames.size(); ++rule)
+        {
+            m_buffer.Append(rule == 0 ? "{\"id\":\"" : ",{\"id\":\"");
+            m_buffer.AppendJsonString(m_runtimeRuleNames[rule]);
+            m_buffer.Append("\"}");
+        }
+        m_buffer.Append("]}},\"results\":[");
+    }
+
+    void Write(const CompilerOutputLineView& view, const DiagnosticDetails& details = {})
+    {
+        switch (m_format)
+        {
+            case OutputFormat::text:
+                WriteText(view, details);
+                break;
+            case OutputFormat::jsonLines:
+                WriteJsonLine(view, details);
+                break;
+            case OutputFormat::sarif:
+                WriteSarifResult(view, details);
+                break;
+        }
+    }
+
+    // Text as it is, for the text format only
+    void WriteRaw(std::string_view text) { m_buffer.Append(text); }
+
+    void End()
+    {
+        if (m_format == OutputFormat::sarif) m_buffer.Append("]}]}\n");
+        m_buffer.Flush();
+    }
+
+    void Flush() { m_buffer.Flush(); }
+
+private:
+    std::string_view RuleName(const CompilerOutputLineView& view) const
+    {
+        if (view.runtimeRule < m_runtimeRuleNames.size()) return m_runtimeRuleNames[view.runtimeRule];
+        return GetCompilerOutputRuleName(view.rule);
+    }
+
+    static std::string_view TypeName(CompilerOutputLineType type)
+    {
+        switch (type)
+        {
+            case CompilerOutputLineType::warning:
+                return "warning";
+            case CompilerOutputLineType::error:
+                return "error";
+            case CompilerOutputLineType::info:
+                return "info";
+            default:
+                return "normal";
+        }
+    }
+
+    void WriteText(const CompilerOutputLineView& view, const DiagnosticDetails& details)
+    {
+        switch (view.type)
+        {
+            case CompilerOutputLineType::warning:
+                m_buffer.Append("WARNING : ");
+                break;
+            case CompilerOutputLineType::error:
+                m_buffer.Append("ERROR : ");
+                break;
+            case CompilerOutputLineType::info:
+                m_buffer.Append("INFO : ");
+                break;
+            default:
+                m_buffer.Append("UNKNOWN : ");
+                break;
+        }
+        if (!view.fileName.empty())
+        {
+            if (view.fileName.front() == '/')
+            {
+                m_buffer.Append("file://");
+                m_buffer.Append(view.fileName);
+                m_buffer.Append(' ');
+            }
+            else
+            {
+                m_buffer.Append(view.fileName);
+            }
+            if (view.line != CompilerOutputLineView::noNumber)
+            {
+                m_buffer.Append(':');
+                m_buffer.AppendNumber(view.line);
+                m_buffer.Append(' ');
+            }
+        }
+        if (view.message.empty()) return;
+        m_buffer.Append(view.message);
+        if (details.count > 1)
+        {
+            m_buffer.Append(" [");
+            m_buffer.AppendNumber(details.count);
+            m_buffer.Append(" times, log lines ");
+            m_buffer.AppendNumber(details.firstLogLine);
+            m_buffer.Append('-');
+            m_buffer.AppendNumber(details.lastLogLine);
+            m_buffer.Append(']');
+        }
+        m_buffer.Append('\n');
+    }
+
+    void WriteJsonLine(const CompilerOutputLineView& view, const DiagnosticDetails& details)
+    {
+        m_buffer.Append("{\"type\":\"");
+        m_buffer.Append(TypeName(view.type));
+        m_buffer.Append("\",\"rule\":\"");
+        m_buffer.AppendJsonString(RuleName(view));
+        m_buffer.Append('"');
+        if (!view.fileName.empty())
+        {
+            m_buffer.Append(",\"file\":\"");
+            m_buffer.AppendJsonString(view.fileName);
+            m_buffer.Append('"');
+        }
+        AppendLineNumberField(",\"line\":", view.line);
+        AppendLineNumberField(",\"column\":", view.column);
+        m_buffer.Append(",\"message\":\"");
+        m_buffer.AppendJsonString(view.message);
+        m_buffer.Append('"');
+        if (details.logLine) AppendNumberField(",\"logLine\":", details.logLine);
+        if (details.count)
+        {
+            AppendNumberField(",\"count\":", details.count);
+            AppendNumberField(",\"firstLogLine\":", details.firstLogLine);
+            AppendNumberField(",\"lastLogLine\":", details.lastLogLine);
+        }
+        m_buffer.Append("}\n");
+    }
+
+    void WriteSarifResult(const CompilerOutputLineView& view, const DiagnosticDetails& details)
+    {
+        m_buffer.Append(m_resultCount++ ? ",\n{\"ruleId\":\"" : "\n{\"ruleId\":\"");
+        m_buffer.AppendJsonString(RuleName(view));
+        m_buffer.Append('"');
+        // Indexes in the rules of Begin()
+        if (!m_runtimeRuleNames.empty())
+        {
+            if (view.runtimeRule < m_runtimeRuleNames.size()) AppendNumberField(",\"ruleIndex\":", view.runtimeRule);
+        }
+        else if (view.rule != CompilerOutputRule::none)
+        {
+            AppendNumberField(",\"ruleIndex\":", static_cast<uint64_t>(view.rule) - 1);
+        }
+        m_buffer.Append(view.type == CompilerOutputLineType::error     ? ",\"level\":\"error\""
+                        : view.type == CompilerOutputLineType::warning ? ",\"level\":\"warning\""
+                                                                       : ",\"level\":\"note\"");
+        m_buffer.Append(",\"message\":{\"text\":\"");
+        // SARIF wants a message, the rule name stands in for an empty one
+        m_buffer.AppendJsonString(view.message.empty() ? RuleName(view) : view.message);
+        m_buffer.Append("\"}");
+        if (!view.fileName.empty())
+        {
+            m_buffer.Append(",\"locations\":[{\"physicalLocation\":{\"artifactLocation\":{\"uri\":\"");
+            AppendUri(view.fileName);
+            m_buffer.Append("\"}");
+            if (view.line != CompilerOutputLineView::noNumber)
+            {
+                AppendLineNumberField(",\"region\":{\"startLine\":", view.line);
+                AppendLineNumberField(",\"startColumn\":", view.column);
+                m_buffer.Append('}');
+            }
+            m_buffer.Append("}}]");
+        }
+        if (details.count) AppendNumberField(",\"occurrenceCount\":", details.count);
+        m_buffer.Append('}');
+    }
+
+    void AppendNumberField(std::string_view name, uint64_t number)
+    {
+        m_buffer.Append(name);
+        m_buffer.AppendNumber(number);
+    }
+
+    void AppendLineNumberField(std::string_view name, uint32_t number)
+    {
+        if (number != CompilerOutputLineView::noNumber) AppendNumberField(name, number);
+    }
+
+    // Absolute paths as file URIs, characters that are not allowed in a URI percent encoded, which leaves nothing to escape for JSON
+    void AppendUri(std::string_view fileName)
+    {
+        if (fileName.front() == '/') m_buffer.Append("file://");
+        size_t runBegin = 0;
+        for (size_t pos = 0; pos < fileName.size(); ++pos)
+        {
+            const unsigned char c = static_cast<unsigned char>(fileName[pos]);
+            if (c > ' ' && c < 0x7f && !strchr("\"%<>\\^`{|}#?[]", c)) continue;
+            m_buffer.Append(fileName.substr(runBegin, pos - runBegin));
+            const char escape[] = {'%', "0123456789ABCDEF"[c >> 4], "0123456789ABCDEF"[c & 15]};
+            m_buffer.Append(std::string_view(escape, sizeof(escape)));
+            runBegin = pos + 1;
+        }
+        m_buffer.Append(fileName.substr(runBegin));
+    }
+
+    OutputFormat m_format;
+    OutputBuffer m_buffer;
+    std::vector<std::string> m_runtimeRuleNames;
+    uint64_t m_resultCount{0};
+};
+
+#endif  // DIAGNOSTIC_WRITER_HPP_INCLUDED
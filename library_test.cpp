@@ -0,0 +1,77 @@
+/*
+ * Compiler Output Parser: Parse error, warning and messages
+ * Copyright (C) 2024  Christo Joseph
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Linked against the compiler-output-parser library, it cannot include compiler_output_parser.hpp as test.cpp does
+#include <memory_resource>
+#include <string>
+#include "compiler_output_parser_lib.hpp"
+
+#include <gtest/gtest.h>
+
+TEST(Library, Line_view_and_info)
+{
+    const std::string testLine = "/home/test/file/path/test.cpp:3:10: fatal error: test.h: No such file or directory";
+    const CompilerOutputLineView view = GetCompilerOutputLineView(testLine);
+    EXPECT_EQ(view.type, CompilerOutputLineType::error);
+    EXPECT_EQ(view.rule, CompilerOutputRule::preprocessorError);
+    EXPECT_STREQ(GetCompilerOutputRuleName(view.rule), "Preprocessor error");
+    EXPECT_STREQ(GetCompilerOutputRuleName(CompilerOutputRule::none), "None");
+    EXPECT_EQ(view.fileName, "/home/test/file/path/test.cpp");
+    EXPECT_EQ(view.line, 3u);
+    EXPECT_EQ(view.column, 10u);
+
+    const CompilerOutputLineInfo info = GetCompilerOutputLineInfo(testLine);
+    EXPECT_EQ(info.type, CompilerOutputLineType::error);
+    EXPECT_EQ(info.line, "3");
+    EXPECT_EQ(info.message, "fatal error: test.h: No such file or directory");
+
+    std::pmr::monotonic_buffer_resource arena;
+    const CompilerOutputPmrLineInfo pmrInfo = GetCompilerOutputLineInfo(testLine, &arena);
+    EXPECT_EQ(pmrInfo.get_allocator().resource(), &arena);
+    EXPECT_EQ(pmrInfo.fileName, "/home/test/file/path/test.cpp");
+    EXPECT_EQ(GetCompilerOutputLineView("[4/265] Building CXX object a.o").type, CompilerOutputLineType::normal);
+}
+
+TEST(Library, Filter)
+{
+    const std::string testLine = "src/a.cpp:3:5: warning: unused variable 'x'";
+    const CompilerOutputFilter errors{.types = CompilerOutputTypeBit(CompilerOutputLineType::error), .filePrefix = {}};
+    const CompilerOutputFilter sources{.types = CompilerOutputFilter::allTypes, .filePrefix = "src/"};
+    EXPECT_EQ(GetCompilerOutputLineView(testLine, errors).type, CompilerOutputLineType::normal);
+    EXPECT_EQ(GetCompilerOutputLineView(testLine, sources).type, CompilerOutputLineType::warning);
+}
+
+TEST(Library, Batch)
+{
+    const std::string buffer =
+        "[1/3] Building CXX object a.o\n"
+        "/src/b.cpp:7:1: error: expected ';' before '}' token\n"
+        "collect2: error: ld returned 1 exit status";
+    const CompilerOutputBatch batch = ParseCompilerOutput(buffer);
+    ASSERT_EQ(batch.Size(), 2u);
+    EXPECT_EQ(batch.files.Name(batch.fileIds[0]), "/src/b.cpp");
+    EXPECT_EQ(batch.fileIds[1], CompilerOutputFileTable::noFile);
+    EXPECT_EQ(batch.rules[1], CompilerOutputRule::generalError);
+    EXPECT_EQ(batch.View(1, buffer).message, "error: ld returned 1 exit status");
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
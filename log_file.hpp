@@ -0,0 +1,235 @@
+/*
+ * Compiler Output Parser: Parse error, warning and messages
+ * Copyright (C) 2024  Christo Joseph
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOG_FILE_HPP_INCLUDED
+#define LOG_FILE_HPP_INCLUDED
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <string_view>
+#include <vector>
+#include "compiler_output_parser.hpp"
+
+/*
+ * A whole log in memory. Regular files are mapped, anything else (pipes, stdin) is read into one growing buffer.
+ */
+class LogFile
+{
+public:
+    LogFile() = default;
+    LogFile(const LogFile&) = delete;
+    LogFile& operator=(const LogFile&) = delete;
+    ~LogFile() { Close(); }
+
+    // path "-" reads stdin, returns false with errno set on failure
+    bool Open(const char* path)
+    {
+        Close();
+        const bool isStdin = std::string_view(path) == "-";
+        const int fd = isStdin ? STDIN_FILENO : open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+        bool ok = false;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+        {
+            // Writable but private, lines can be edited in place without touching the file
+            void* mapping = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED)
+            {
+                madvise(mapping, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+                m_mapping = mapping;
+                m_mappingSize = static_cast<size_t>(st.st_size);
+                m_data = std::string_view(static_cast<const char*>(mapping), m_mappingSize);
+                ok = true;
+            }
+        }
+        if (!ok) ok = ReadAll(fd);
+        const int savedErrno = errno;
+        if (!isStdin) close(fd);
+        errno = savedErrno;
+        return ok;
+    }
+
+    std::string_view Data() const { return m_data; }
+
+private:
+    static constexpr size_t readChunkSize = 4 << 20;
+
+    bool ReadAll(int fd)
+    {
+        size_t size = 0;
+        for (;;)
+        {
+            if (m_buffer.size() - size < readChunkSize) m_buffer.resize(std::max(m_buffer.size() * 2, size + readChunkSize));
+            const ssize_t count = read(fd, m_buffer.data() + size, m_buffer.size() - size);
+            if (count < 0)
+            {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            if (count == 0) break;
+            size += static_cast<size_t>(count);
+        }
+        m_data = std::string_view(m_buffer.data(), size);
+        return true;
+    }
+
+    void Close()
+    {
+        if (m_mapping) munmap(m_mapping, m_mappingSize);
+        m_mapping = nullptr;
+        m_mappingSize = 0;
+        m_buffer.clear();
+        m_data = {};
+    }
+
+    void* m_mapping{nullptr};
+    size_t m_mappingSize{0};
+    std::vector<char> m_buffer;
+    std::string_view m_data;
+};
+
+/*
+ * A log read as it is written, through a buffer that only grows to hold the longest line. With follow, the end of a
+ * regular file is not the end of the log: reading waits for more data like tail -f, and starts over when the file is
+ * truncated.
+ */
+class LogStream
+{
+public:
+    explicit LogStream(bool follow) : m_follow(follow) {}
+    LogStream(const LogStream&) = delete;
+    LogStream& operator=(const LogStream&) = delete;
+    ~LogStream()
+    {
+        if (m_fd > STDIN_FILENO) close(m_fd);
+    }
+
+    // path "-" reads stdin, returns false with errno set on failure
+    bool Open(const char* path)
+    {
+        m_fd = std::string_view(path) == "-" ? STDIN_FILENO : open(path, O_RDONLY | O_CLOEXEC);
+        if (m_fd < 0) return false;
+        struct stat st;
+        if (fstat(m_fd, &st) != 0) return false;
+        m_regularFile = S_ISREG(st.st_mode);
+        m_buffer.resize(initialBufferSize);
+        return true;
+    }
+
+    /*
+     * Waits for data and calls onLine(std::string_view) for every line it completes, the views are valid during the call.
+     * Returns false at the end of the log, after the last line, or on a read error reported by Error().
+     */
+    template <typename OnLine>
+    bool ReadLines(OnLine&& onLine)
+    {
+        if (m_end == m_buffer.size())
+        {
+            if (m_begin == 0) m_buffer.resize(m_buffer.size() * 2);
+            std::copy(m_buffer.begin() + m_begin, m_buffer.begin() + m_end, m_buffer.begin());
+            m_end -= m_begin;
+            m_begin = 0;
+        }
+        const ssize_t count = Read(m_buffer.data() + m_end, m_buffer.size() - m_end);
+        if (count < 0) m_error = errno;
+        if (count <= 0)
+        {
+            if (m_begin < m_end) onLine(TrimLine(std::string_view(m_buffer.data() + m_begin, m_end - m_begin)));
+            m_begin = m_end = 0;
+            return false;
+        }
+        const std::string_view data(m_buffer.data() + m_begin, m_end + static_cast<size_t>(count) - m_begin);
+        const size_t lastNewline = data.rfind('\n');
+        if (lastNewline != std::string_view::npos)
+        {
+            ForEachCompilerOutputLine(data.substr(0, lastNewline + 1), onLine);
+            m_begin += lastNewline + 1;
+        }
+        m_end += static_cast<size_t>(count);
+        if (m_begin == m_end) m_begin = m_end = 0;
+        return true;
+    }
+
+    int Error() const { return m_error; }
+
+private:
+    static constexpr size_t initialBufferSize = 1 << 20;
+    static constexpr useconds_t followInterval = 100000;
+
+    static std::string_view TrimLine(std::string_view line)
+    {
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        return line;
+    }
+
+    ssize_t Read(char* data, size_t size)
+    {
+        for (;;)
+        {
+            const ssize_t count = read(m_fd, data, size);
+            if (count < 0 && errno == EINTR) continue;
+            if (count != 0 || !m_follow || !m_regularFile) return count;
+            struct stat st;
+            const off_t position = lseek(m_fd, 0, SEEK_CUR);
+            if (fstat(m_fd, &st) == 0 && position > st.st_size)
+            {
+                // Truncated, the partial line read before is dropped
+                lseek(m_fd, 0, SEEK_SET);
+                m_begin = m_end = 0;
+                data = m_buffer.data();
+                size = m_buffer.size();
+                continue;
+            }
+            usleep(followInterval);
+        }
+    }
+
+    bool m_follow;
+    bool m_regularFile{false};
+    int m_fd{-1};
+    int m_error{0};
+    std::vector<char> m_buffer;
+    size_t m_begin{0};
+    size_t m_end{0};
+};
+
+// Splits data into pieces of about chunkSize bytes, each ending right after a '\n' or at the end of data
+inline std::vector<std::string_view> SplitIntoChunks(std::string_view data, size_t chunkSize)
+{
+    std::vector<std::string_view> chunks;
+    size_t begin = 0;
+    while (begin < data.size())
+    {
+        size_t end = data.size();
+        if (data.size() - begin > chunkSize)
+        {
+            const size_t newline = data.find('\n', begin + chunkSize - 1);
+            if (newline != std::string_view::npos) end = newline + 1;
+        }
+        chunks.push_back(data.substr(begin, end - begin));
+        begin = end;
+    }
+    return chunks;
+}
+
+#endif  // LOG_FILE_HPP_INCLUDED
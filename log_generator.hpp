@@ -0,0 +1,207 @@
+/*
+ * Compiler Output Parser: Parse error, warning and messages
+ * Copyright (C) 2024  Christo Joseph
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOG_GENERATOR_HPP_INCLUDED
+#define LOG_GENERATOR_HPP_INCLUDED
+
+#include <array>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+
+/*
+ * Synthetic build log in the shape of a ninja + GCC + binutils build: progress lines and long command lines for the
+ * most part, with diagnostics, include chains and template backtraces in between, link errors at the end of targets and
+ * lines that look like diagnostics without being one. The same seed always gives the same log.
+ */
+class SyntheticLogGenerator
+{
+public:
+    explicit SyntheticLogGenerator(uint64_t seed = 1) : m_random(seed) {}
+
+    // At least size bytes of whole lines
+    std::string Generate(size_t size)
+    {
+        std::string log;
+        log.reserve(size + 64 * 1024);
+        while (log.size() < size) AppendTarget(log);
+        return log;
+    }
+
+private:
+    static constexpr std::array<std::string_view, 8> directories = {
+        "src/core", "src/net", "src/ui/widgets", "lib/json/include/json", "third_party/abseil/absl/strings",
+        "plugins/compiler", "tests/unit", "build/generated"};
+    static constexpr std::array<std::string_view, 10> baseNames = {
+        "parser", "message_queue", "thread_pool", "string_utils", "config", "socket", "editor_base", "main", "allocator", "json_value"};
+    static constexpr std::array<std::string_view, 8> warnings = {
+        "unused variable 'count' [-Wunused-variable]",
+        "comparison of integer expressions of different signedness: 'int' and 'size_t' [-Wsign-compare]",
+        "'result' may be used uninitialized [-Wmaybe-uninitialized]",
+        "unused parameter 'event' [-Wunused-parameter]",
+        "implicit conversion from 'double' to 'float' changes value [-Wfloat-conversion]",
+        "control reaches end of non-void function [-Wreturn-type]",
+        "'void Base::Update()' was hidden [-Woverloaded-virtual=]",
+        "this statement may fall through [-Wimplicit-fallthrough=]"};
+    static constexpr std::array<std::string_view, 6> errors = {
+        "'Widget' was not declared in this scope",
+        "expected ';' before '}' token",
+        "no matching function for call to 'Parse(const char*&, int)'",
+        "invalid use of incomplete type 'class Socket'",
+        "'value_type' in 'struct std::iterator_traits<int>' does not name a type",
+        "cannot convert 'std::string' {aka 'std::__cxx11::basic_string<char>'} to 'const char*'"};
+    static constexpr std::array<std::string_view, 9> nearMisses = {
+        "-- Looking for pthread.h - found",
+        "ninja: entering directory `build/release'",
+        "See https://gcc.gnu.org/bugs/ for instructions: error reporting is documented there",
+        "Checking std::vector<std::pair<int, int>>::iterator: done",
+        "Test #12: json_value.roundtrip ...........   Passed    0.02 sec",
+        "make[2]: Leaving directory '/home/user/project/build' (warnings are errors in this directory)",
+        "  | std::map<std::string, std::vector<int>>::const_iterator it = m.find(key); // note this is not a diagnostic",
+        "2024-05-01T12:30:45.123Z [INFO] cache hit for src/core/parser.cpp:1234 (objects: 3)",
+        "Error 2 ignored in rule all:release:debug"};
+
+    size_t Pick(size_t count) { return std::uniform_int_distribution<size_t>(0, count - 1)(m_random); }
+    bool Chance(double probability) { return std::bernoulli_distribution(probability)(m_random); }
+    unsigned Number(unsigned low, unsigned high) { return std::uniform_int_distribution<unsigned>(low, high)(m_random); }
+
+    std::string FileName(std::string_view extension)
+    {
+        std::string name = "/home/user/project/";
+        name += directories[Pick(directories.size())];
+        name += '/';
+        name += baseNames[Pick(baseNames.size())];
+        name += extension;
+        return name;
+    }
+
+    std::string Location(const std::string& fileName, bool column)
+    {
+        std::string location = fileName + ':' + std::to_string(Number(1, 4000)) + ':';
+        if (column) location += std::to_string(Number(1, 120)) + ':';
+        return location;
+    }
+
+    void AppendCommandLine(std::string& log, const std::string& source)
+    {
+        log += "/usr/bin/c++ -DNDEBUG -DPROJECT_VERSION=\\\"2.4.1\\\"";
+        const unsigned includes = Number(8, 40);
+        for (unsigned index = 0; index < includes; ++index)
+        {
+            log += " -I/home/user/project/";
+            log += directories[Pick(directories.size())];
+            log += "/include";
+        }
+        log += " -O2 -g -fPIC -Wall -Wextra -std=gnu++20 -MD -MT CMakeFiles/project.dir/obj.o -MF CMakeFiles/project.dir/obj.o.d";
+        log += " -o CMakeFiles/project.dir/obj.o -c ";
+        log += source;
+        log += '\n';
+    }
+
+    void AppendIncludeChain(std::string& log)
+    {
+        const unsigned depth = Number(1, 3);
+        for (unsigned index = 0; index < depth; ++index)
+        {
+            log += index == 0 ? "In file included from " : "                 from ";
+            log += Location(FileName(".hpp"), false);
+            log += index + 1 == depth ? ":\n" : ",\n";
+        }
+    }
+
+    void AppendTemplateBacktrace(std::string& log, const std::string& source)
+    {
+        const std::string header = "/usr/include/c++/13/bits/stl_vector.h";
+        log += header + ": In instantiation of 'void std::vector<_Tp, _Alloc>::_M_realloc_insert(iterator, _Args&& ...) [with _Args = "
+                        "{const Widget&}; _Tp = Widget; _Alloc = std::allocator<Widget>]':\n";
+        const unsigned frames = Number(2, 6);
+        for (unsigned index = 0; index < frames; ++index)
+        {
+            log += Location(index % 2 ? source : header, true);
+            log += "   required from 'void std::vector<_Tp, _Alloc>::push_back(const value_type&) [with _Tp = Widget]'\n";
+        }
+        if (Chance(0.3))
+        {
+            log += Location(header, true);
+            log += "   [ skipping " + std::to_string(Number(2, 20)) + " instantiation contexts, use -ftemplate-backtrace-limit=0 to disable ]\n";
+        }
+        log += Location(source, true) + "   required from here\n";
+        log += Location(header, true) + " error: ";
+        log += errors[Pick(errors.size())];
+        log += '\n';
+        log += Location(header, true) + " note: candidate: 'template<class _Tp> void Emplace(_Tp&&)'\n";
+    }
+
+    void AppendDiagnostics(std::string& log, const std::string& source)
+    {
+        if (Chance(0.5)) AppendIncludeChain(log);
+        log += source + ": In member function 'void Editor::Update(const Event&)':\n";
+        const unsigned count = Number(1, 4);
+        for (unsigned index = 0; index < count; ++index)
+        {
+            const bool error = Chance(0.2);
+            log += Location(source, Chance(0.9));
+            log += error ? " error: " : " warning: ";
+            log += error ? errors[Pick(errors.size())] : warnings[Pick(warnings.size())];
+            log += '\n';
+            log += "  " + std::to_string(Number(1, 4000)) + " |     const int result = Compute(value, flags);\n";
+            log += "      |               ^~~~~~\n";
+            if (Chance(0.4)) log += Location(source, true) + " note: declared here\n";
+        }
+        if (Chance(0.2)) AppendTemplateBacktrace(log, source);
+    }
+
+    void AppendLinkErrors(std::string& log)
+    {
+        const std::string object = "CMakeFiles/project.dir/src/core/" + std::string(baseNames[Pick(baseNames.size())]) + ".cpp.o";
+        log += "/usr/bin/ld: " + object + ": in function `Parser::Run()':\n";
+        log += Location(FileName(".cpp"), false) + " undefined reference to `Socket::Send(std::basic_string_view<char>)'\n";
+        log += "/usr/bin/ld: " + object + ":(.text+0x" + std::to_string(Number(16, 4095)) + "): undefined reference to `Widget::Widget()'\n";
+        if (Chance(0.3)) log += "/usr/bin/ld: cannot find -lprotobuf: No such file or directory\n";
+        log += "collect2: error: ld returned 1 exit status\n";
+    }
+
+    void AppendNearMisses(std::string& log)
+    {
+        log += nearMisses[Pick(nearMisses.size())];
+        log += '\n';
+        if (Chance(0.1))
+        {
+            // A long run of ':' with no line number after any of them, the location rules look at each one before giving up
+            for (unsigned index = 0; index < 64; ++index) log += "/very/long/path/segment:";
+            log += " no line number follows any of these\n";
+        }
+    }
+
+    void AppendTarget(std::string& log)
+    {
+        const std::string source = FileName(Chance(0.8) ? ".cpp" : ".c");
+        ++m_step;
+        log += '[' + std::to_string(m_step) + '/' + std::to_string(m_step + Number(1, 500)) + "] Building CXX object " + source + ".o\n";
+        if (Chance(0.5)) AppendCommandLine(log, source);
+        if (Chance(0.25)) AppendDiagnostics(log, source);
+        if (Chance(0.1)) AppendNearMisses(log);
+        if (Chance(0.02)) AppendLinkErrors(log);
+    }
+
+    std::mt19937_64 m_random;
+    unsigned m_step{0};
+};
+
+#endif  // LOG_GENERATOR_HPP_INCLUDED
@@ -0,0 +1,402 @@
+/*
+ * Compiler Output Parser: Parse error, warning and messages
+ * Copyright (C) 2024  Christo Joseph
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOG_INDEX_HPP_INCLUDED
+#define LOG_INDEX_HPP_INCLUDED
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "compiler_output_parser.hpp"
+
+/*
+ * Diagnostics of a log kept in a file next to it, so that later runs only parse what was appended to the log since.
+ * The file is a LogIndexHeader followed by one segment per update, in native byte order: a LogIndexSegmentHeader, its
+ * records, the file names first seen in it and the text those point into. Everything is 8 byte aligned so the file can
+ * be mapped and read in place. The header is written last, bytes after LogIndexHeader::size are a torn update.
+ */
+struct LogIndexHeader
+{
+    static constexpr char magicValue[8] = {'C', 'O', 'P', 'I', 'N', 'D', 'E', 'X'};
+    static constexpr uint32_t currentVersion = 3;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t segmentCount;
+    uint64_t size;        // of the index up to the end of the last segment
+    uint64_t parsedSize;  // of the log, always right after a '\n'
+    uint64_t lineCount;   // in the parsed part of the log
+    uint64_t headHash;    // of the first bytes of the log
+    uint64_t tailHash;    // of the bytes before parsedSize
+    uint64_t rulesHash;   // of the rules the log was parsed with, 0 for the built-in rules
+};
+
+struct LogIndexSegmentHeader
+{
+    uint64_t recordCount;
+    uint64_t fileNameCount;
+    uint64_t textSize;
+};
+
+// In the text of the segment it is stored in
+struct LogIndexFileName
+{
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct LogIndexRecord
+{
+    static constexpr uint32_t noFileName = UINT32_MAX;
+
+    uint64_t logLine;  // 1 based
+    uint64_t message;  // offset in the text of the segment
+    uint32_t messageSize;
+    uint32_t fileName;  // among the file names of all segments
+    uint32_t line;
+    uint32_t column;
+    CompilerOutputLineType type;
+    CompilerOutputRule rule;
+    uint8_t reserved{};  // zero, the records are written as they are
+    uint16_t runtimeRule;
+};
+
+static_assert(sizeof(LogIndexHeader) % 8 == 0 && sizeof(LogIndexSegmentHeader) % 8 == 0);
+static_assert(sizeof(LogIndexFileName) % 8 == 0 && sizeof(LogIndexRecord) % 8 == 0);
+// No padding, which would write uninitialized bytes to the file
+static_assert(std::has_unique_object_representations_v<LogIndexHeader> && std::has_unique_object_representations_v<LogIndexSegmentHeader>);
+static_assert(std::has_unique_object_representations_v<LogIndexFileName> && std::has_unique_object_representations_v<LogIndexRecord>);
+
+namespace log_index_detail
+{
+// How much of the log around parsedSize is compared to tell an appended log from a replaced one
+constexpr size_t hashedSize = 4096;
+
+inline uint64_t HeadHash(std::string_view log, uint64_t parsedSize)
+{
+    using namespace compiler_output_parser_detail;
+    return HashBytes(hashSeed, log.substr(0, std::min<uint64_t>(parsedSize, hashedSize)));
+}
+
+inline uint64_t TailHash(std::string_view log, uint64_t parsedSize)
+{
+    using namespace compiler_output_parser_detail;
+    const uint64_t size = std::min<uint64_t>(parsedSize, hashedSize);
+    return HashBytes(hashSeed, log.substr(parsedSize - size, size));
+}
+
+constexpr uint64_t Align(uint64_t size) { return (size + 7) & ~uint64_t{7}; }
+
+inline bool WriteAll(int fd, const void* data, size_t size, uint64_t offset)
+{
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0)
+    {
+        const ssize_t count = pwrite(fd, bytes, size, static_cast<off_t>(offset));
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) return false;
+        bytes += count;
+        size -= static_cast<size_t>(count);
+        offset += static_cast<uint64_t>(count);
+    }
+    return true;
+}
+}  // namespace log_index_detail
+
+// An index file mapped for reading
+class LogIndex
+{
+public:
+    LogIndex() = default;
+    LogIndex(const LogIndex&) = delete;
+    LogIndex& operator=(const LogIndex&) = delete;
+    ~LogIndex() { Close(); }
+
+    // Returns false with errno set when the file cannot be read, EBADMSG when it is not a valid index
+    bool Open(const char* path)
+    {
+        Close();
+        const int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+        struct stat st;
+        bool ok = fstat(fd, &st) == 0;
+        if (ok && static_cast<uint64_t>(st.st_size) >= sizeof(LogIndexHeader))
+        {
+            void* mapping = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+            ok = mapping != MAP_FAILED;
+            if (ok)
+            {
+                m_mapping = static_cast<const char*>(mapping);
+                m_mappingSize = static_cast<size_t>(st.st_size);
+            }
+        }
+        const int savedErrno = errno;
+        close(fd);
+        errno = savedErrno;
+        if (ok && !Load())
+        {
+            Close();
+            errno = EBADMSG;
+            ok = false;
+        }
+        return ok;
+    }
+
+    bool IsOpen() const { return m_header != nullptr; }
+
+    const LogIndexHeader& Header() const { return *m_header; }
+
+    // Whether log is the indexed log parsed with the same rules, possibly with more lines appended since
+    bool Matches(std::string_view log, uint64_t rulesHash) const
+    {
+        return m_header->rulesHash == rulesHash && m_header->parsedSize <= log.size() &&
+               m_header->headHash == log_index_detail::HeadHash(log, m_header->parsedSize) &&
+               m_header->tailHash == log_index_detail::TailHash(log, m_header->parsedSize);
+    }
+
+    const std::vector<std::string_view>& FileNames() const { return m_fileNames; }
+
+    size_t RecordCount() const
+    {
+        size_t count = 0;
+        for (const Segment& segment : m_segments) count += segment.recordCount;
+        return count;
+    }
+
+    // Calls onRecord(const LogIndexRecord&, const CompilerOutputLineView&) in log order, the views point into the index
+    template <typename OnRecord>
+    void ForEach(OnRecord&& onRecord) const
+    {
+        for (const Segment& segment : m_segments)
+        {
+            for (size_t index = 0; index < segment.recordCount; ++index)
+            {
+                const LogIndexRecord& record = segment.records[index];
+                onRecord(record, View(record, segment));
+            }
+        }
+    }
+
+    void Close()
+    {
+        if (m_mapping) munmap(const_cast<char*>(m_mapping), m_mappingSize);
+        m_mapping = nullptr;
+        m_mappingSize = 0;
+        m_header = nullptr;
+        m_segments.clear();
+        m_fileNames.clear();
+    }
+
+private:
+    struct Segment
+    {
+        const LogIndexRecord* records;
+        size_t recordCount;
+        const char* text;
+    };
+
+    CompilerOutputLineView View(const LogIndexRecord& record, const Segment& segment) const
+    {
+        return {.type = record.type,
+                .rule = record.rule,
+                .runtimeRule = record.runtimeRule,
+                .line = record.line,
+                .column = record.column,
+                .fileName = record.fileName == LogIndexRecord::noFileName ? std::string_view() : m_fileNames[record.fileName],
+                .message = std::string_view(segment.text + record.message, record.messageSize)};
+    }
+
+    // Checks every offset against the mapping, so that a damaged file cannot make the views point outside it
+    bool Load()
+    {
+        if (!m_mapping) return false;
+        const LogIndexHeader* header = reinterpret_cast<const LogIndexHeader*>(m_mapping);
+        if (memcmp(header->magic, LogIndexHeader::magicValue, sizeof(header->magic)) != 0 || header->version != LogIndexHeader::currentVersion ||
+            header->size > m_mappingSize || header->size < sizeof(LogIndexHeader))
+        {
+            return false;
+        }
+        uint64_t offset = sizeof(LogIndexHeader);
+        for (uint32_t segmentIndex = 0; segmentIndex < header->segmentCount; ++segmentIndex)
+        {
+            if (header->size - offset < sizeof(LogIndexSegmentHeader)) return false;
+            const LogIndexSegmentHeader* segmentHeader = reinterpret_cast<const LogIndexSegmentHeader*>(m_mapping + offset);
+            offset += sizeof(LogIndexSegmentHeader);
+            const uint64_t remaining = header->size - offset;
+            if (segmentHeader->recordCount > remaining / sizeof(LogIndexRecord) ||
+                segmentHeader->fileNameCount > (remaining - segmentHeader->recordCount * sizeof(LogIndexRecord)) / sizeof(LogIndexFileName))
+            {
+                return false;
+            }
+            const uint64_t tableSize = segmentHeader->recordCount * sizeof(LogIndexRecord) + segmentHeader->fileNameCount * sizeof(LogIndexFileName);
+            if (segmentHeader->textSize > remaining - tableSize) return false;
+            const Segment segment{reinterpret_cast<const LogIndexRecord*>(m_mapping + offset), segmentHeader->recordCount,
+                                  m_mapping + offset + tableSize};
+            const LogIndexFileName* fileNames =
+                reinterpret_cast<const LogIndexFileName*>(m_mapping + offset + segmentHeader->recordCount * sizeof(LogIndexRecord));
+            for (uint64_t index = 0; index < segmentHeader->fileNameCount; ++index)
+            {
+                const LogIndexFileName& fileName = fileNames[index];
+                if (fileName.offset > segmentHeader->textSize || fileName.size > segmentHeader->textSize - fileName.offset) return false;
+                m_fileNames.emplace_back(segment.text + fileName.offset, fileName.size);
+            }
+            for (size_t index = 0; index < segment.recordCount; ++index)
+            {
+                const LogIndexRecord& record = segment.records[index];
+                if (record.message > segmentHeader->textSize || record.messageSize > segmentHeader->textSize - record.message) return false;
+                if (record.fileName != LogIndexRecord::noFileName && record.fileName >= m_fileNames.size()) return false;
+                // Used as table indexes by the rule names and the writers
+                if (record.type > CompilerOutputLineType::info || static_cast<size_t>(record.rule) >= compilerOutputRuleCount) return false;
+            }
+            m_segments.push_back(segment);
+            offset += tableSize + segmentHeader->textSize;
+        }
+        if (offset != header->size) return false;
+        m_header = header;
+        return true;
+    }
+
+    const char* m_mapping{nullptr};
+    size_t m_mappingSize{0};
+    const LogIndexHeader* m_header{nullptr};
+    std::vector<Segment> m_segments;
+    std::vector<std::string_view> m_fileNames;
+};
+
+// The diagnostics of one update, written as a segment
+class LogIndexSegment
+{
+public:
+    // Names already in index keep their ids, a closed index has none
+    explicit LogIndexSegment(const LogIndex& index)
+    {
+        for (std::string_view fileName : index.FileNames()) m_files.Intern(fileName);
+        m_firstNewFile = m_files.Size();
+    }
+
+    void Add(const CompilerOutputLineView& view, uint64_t logLine)
+    {
+        const uint32_t fileName = m_files.Intern(view.fileName);
+        m_records.push_back({.logLine = logLine,
+                             .message = m_text.size(),
+                             .messageSize = static_cast<uint32_t>(view.message.size()),
+                             .fileName = fileName == CompilerOutputFileTable::noFile ? LogIndexRecord::noFileName : fileName,
+                             .line = view.line,
+                             .column = view.column,
+                             .type = view.type,
+                             .rule = view.rule,
+                             .reserved = 0,
+                             .runtimeRule = view.runtimeRule});
+        m_text += view.message;
+    }
+
+    size_t Size() const { return m_records.size(); }
+
+    // Writes the segment at offset and sets size to its size, returns false with errno set on failure
+    bool Write(int fd, uint64_t offset, uint64_t& size)
+    {
+        using namespace log_index_detail;
+        std::vector<LogIndexFileName> fileNames;
+        for (size_t id = m_firstNewFile; id < m_files.Size(); ++id)
+        {
+            const std::string_view fileName = m_files.Name(static_cast<uint32_t>(id));
+            fileNames.push_back({m_text.size(), fileName.size()});
+            m_text += fileName;
+        }
+        m_text.resize(Align(m_text.size()));
+        const LogIndexSegmentHeader header{m_records.size(), fileNames.size(), m_text.size()};
+        const size_t recordsSize = m_records.size() * sizeof(LogIndexRecord);
+        const size_t fileNamesSize = fileNames.size() * sizeof(LogIndexFileName);
+        size = sizeof(header) + recordsSize + fileNamesSize + m_text.size();
+        return WriteAll(fd, &header, sizeof(header), offset) && WriteAll(fd, m_records.data(), recordsSize, offset + sizeof(header)) &&
+               WriteAll(fd, fileNames.data(), fileNamesSize, offset + sizeof(header) + recordsSize) &&
+               WriteAll(fd, m_text.data(), m_text.size(), offset + sizeof(header) + recordsSize + fileNamesSize);
+    }
+
+private:
+    CompilerOutputFileTable m_files;
+    size_t m_firstNewFile{0};
+    std::vector<LogIndexRecord> m_records;
+    std::string m_text;
+};
+
+/*
+ * Brings the index at indexPath up to date with log and leaves it open in index. Only the whole lines appended since
+ * the last update are parsed, by parse(std::string_view lines, uint64_t firstLogLine, LogIndexSegment&), which returns
+ * their number. A log that no longer starts like the indexed one, or that was indexed with other rules than those of
+ * rulesHash, is indexed again from the start. Returns false with errno set on failure.
+ */
+template <typename Parse>
+bool UpdateLogIndex(const char* indexPath, std::string_view log, uint64_t rulesHash, LogIndex& index, Parse&& parse)
+{
+    using namespace log_index_detail;
+    const bool append = index.Open(indexPath) && index.Matches(log, rulesHash);
+    if (!append) index.Close();
+    const LogIndexHeader previous = append ? index.Header() : LogIndexHeader{};
+    // npos + 1 is 0 for a log without a whole line
+    const size_t end = log.rfind('\n') + 1;
+    if (append && end <= previous.parsedSize) return true;
+
+    // Before parse, which may edit the lines in place
+    const uint64_t headHash = HeadHash(log, end);
+    const uint64_t tailHash = TailHash(log, end);
+    LogIndexSegment segment(index);
+    const uint64_t lineCount = parse(log.substr(previous.parsedSize, end - previous.parsedSize), previous.lineCount + 1, segment);
+    index.Close();
+
+    LogIndexHeader header = previous;
+    if (!append)
+    {
+        memcpy(header.magic, LogIndexHeader::magicValue, sizeof(header.magic));
+        header.version = LogIndexHeader::currentVersion;
+        header.size = sizeof(LogIndexHeader);
+        header.rulesHash = rulesHash;
+    }
+    const uint64_t segmentOffset = header.size;
+    uint64_t segmentSize = 0;
+    header.segmentCount += 1;
+    header.parsedSize = end;
+    header.lineCount += lineCount;
+    header.headHash = headHash;
+    header.tailHash = tailHash;
+
+    const int fd = open(indexPath, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    // A fresh index is started with an empty header, so that a failure half way leaves no valid index behind
+    const LogIndexHeader empty{};
+    bool ok = append || (ftruncate(fd, 0) == 0 && WriteAll(fd, &empty, sizeof(empty), 0));
+    ok = ok && segment.Write(fd, segmentOffset, segmentSize) && fdatasync(fd) == 0;
+    header.size = segmentOffset + segmentSize;
+    ok = ok && WriteAll(fd, &header, sizeof(header), 0);
+    ok = ok && ftruncate(fd, static_cast<off_t>(header.size)) == 0;
+    const int savedErrno = errno;
+    close(fd);
+    errno = savedErrno;
+    return ok && index.Open(indexPath);
+}
+
+#endif  // LOG_INDEX_HPP_INCLUDED
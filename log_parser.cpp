@@ -1,70 +1,907 @@
+#include <atomic>
+#include <cstdlib>
 #include <cstring>
-#include <fstream>
+#include <filesystem>
+#include <string>
 #include <vector>
+#include "build_command.hpp"
 #include "compiler_output_parser.hpp"
+#include "compiler_output_runtime_rules.hpp"
+#include "compressed_log.hpp"
+#include "diagnostic_writer.hpp"
+#include "log_file.hpp"
+#include "log_index.hpp"
+#include "parallel_for.hpp"
 
-int main(int argc, char* argv[])
+namespace
+{
+// Lines are handed out to the threads in pieces of this size
+constexpr size_t parallelChunkSize = 4 << 20;
+
+struct Options
+{
+    const char* path{nullptr};
+    unsigned jobs{1};
+    bool stream{false};
+    bool follow{false};
+    bool stats{false};
+    bool dedupe{false};
+    bool group{false};
+    bool index{false};
+    OutputFormat format{OutputFormat::text};
+    // --type and --file-prefix
+    CompilerOutputFilter filter;
+    size_t maxErrors{0};
+    const char* rulesPath{nullptr};
+    // Of the --rules file, tells the indexes of its rules from those of the built-in rules
+    uint64_t rulesHash{0};
+    // Build-wrapper mode, the command after -- and where its output goes besides the parser
+    char** command{nullptr};
+    const char* teePath{nullptr};
+    // Only print the diagnostics that the baseline log does not have
+    const char* baselinePath{nullptr};
+    std::vector<std::string_view> stripPrefixes;
+    // Counts over all the logs of paths instead of the diagnostics
+    bool summary{false};
+    size_t top{10};
+    std::vector<const char*> paths;
+};
+
+void PrintUsage(const char* program)
+{
+    fprintf(stderr,
+            "Usage %s [options] <log file | ->\n"
+            "      %s [options] -- command [arguments]\n"
+            "      %s --summary [options] <log file | directory>...\n"
+            "gzip and zstd compressed logs are decompressed while they are parsed, a command is run with its stdout and stderr\n"
+            "parsed as they are written and passed through to stderr\n"
+            "  -j, --jobs N        parse with N threads, 0 for one per CPU\n"
+            "  --stream            print each diagnostic as soon as its line is read\n"
+            "  -f, --follow        like --stream, and keep reading the log as it grows\n"
+            "  --max-errors N      stop after N errors and exit with status 1\n"
+            "  --stats             print per rule hits, rejections and time to stderr\n"
+            "  --dedupe            print repeated diagnostics once, with their count and first and last log lines\n"
+            "  --group             print each diagnostic followed by its context, notes and source lines, on one thread\n"
+            "  --index             keep the diagnostics in <log file>.idx, later runs only parse what was appended to the log\n"
+            "  --type T[,T...]     only print diagnostics of type error, warning or info, the other rules are not tried\n"
+            "  --file-prefix P     only print diagnostics in files whose name starts with P\n"
+            "  --format F          text (the default), jsonl for a JSON object per line or sarif for a SARIF 2.1.0 log\n"
+            "  --rules FILE        parse with the <RegEx> rules of a Code::Blocks compiler XML instead of the built-in rules\n"
+            "  --tee FILE          with a command, write its output to FILE instead of stderr\n"
+            "  --baseline FILE     only print the diagnostics of the log that FILE does not have, exit with 1 when there is an\n"
+            "                      error or warning among them\n"
+            "  --strip-prefix DIR  with --baseline, compare file names without the build directory DIR, may be repeated\n"
+            "  --summary           print diagnostic counts by type, rule and file over all the logs, those of directories\n"
+            "                      included, with -j N logs parsed at a time\n"
+            "  --top N             with --summary, list the N files with the most diagnostics and the N most frequent warnings\n",
+            program, program, program);
+}
+
+// Comma separated type names into types
+bool ParseTypes(std::string_view names, uint32_t& types)
+{
+    while (!names.empty())
+    {
+        const size_t comma = std::min(names.find(','), names.size());
+        const std::string_view name = names.substr(0, comma);
+        if (name == "error") types |= CompilerOutputTypeBit(CompilerOutputLineType::error);
+        else if (name == "warning") types |= CompilerOutputTypeBit(CompilerOutputLineType::warning);
+        else if (name == "info") types |= CompilerOutputTypeBit(CompilerOutputLineType::info);
+        else return false;
+        names.remove_prefix(std::min(comma + 1, names.size()));
+    }
+    return true;
+}
+
+bool ParseOptions(int argc, char* argv[], Options& options)
+{
+    uint32_t types = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        if ((arg == "-j" || arg == "--jobs") && i + 1 < argc)
+        {
+            const int jobs = atoi(argv[++i]);
+            if (jobs < 0) return false;
+            options.jobs = jobs ? static_cast<unsigned>(jobs) : DefaultJobCount();
+        }
+        else if (arg == "--stream")
+        {
+            options.stream = true;
+        }
+        else if (arg == "-f" || arg == "--follow")
+        {
+            options.stream = options.follow = true;
+        }
+        else if (arg == "--group")
+        {
+            options.group = true;
+        }
+        else if (arg == "--index")
+        {
+            options.index = true;
+        }
+        else if (arg == "--type" && i + 1 < argc)
+        {
+            if (!ParseTypes(argv[++i], types)) return false;
+        }
+        else if (arg == "--file-prefix" && i + 1 < argc)
+        {
+            options.filter.filePrefix = argv[++i];
+        }
+        else if (arg == "--format" && i + 1 < argc)
+        {
+            const std::string_view format = argv[++i];
+            if (format == "text") options.format = OutputFormat::text;
+            else if (format == "jsonl") options.format = OutputFormat::jsonLines;
+            else if (format == "sarif") options.format = OutputFormat::sarif;
+            else return false;
+        }
+        else if (arg == "--dedupe")
+        {
+            options.dedupe = true;
+        }
+        else if (arg == "--stats")
+        {
+            options.stats = true;
+        }
+        else if (arg == "--rules" && i + 1 < argc)
+        {
+            options.rulesPath = argv[++i];
+        }
+        else if (arg == "--max-errors" && i + 1 < argc)
+        {
+            options.maxErrors = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--baseline" && i + 1 < argc)
+        {
+            options.baselinePath = argv[++i];
+        }
+        else if (arg == "--strip-prefix" && i + 1 < argc)
+        {
+            // An empty directory would strip nothing, it is more likely an unset variable
+            if (*argv[++i] == '\0') return false;
+            options.stripPrefixes.push_back(argv[i]);
+        }
+        else if (arg == "--summary")
+        {
+            options.summary = true;
+        }
+        else if (arg == "--top" && i + 1 < argc)
+        {
+            options.top = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--tee" && i + 1 < argc)
+        {
+            options.teePath = argv[++i];
+        }
+        else if (arg == "--" && i + 1 < argc)
+        {
+            options.command = argv + i + 1;
+            break;
+        }
+        else if (arg.starts_with("-") && arg != "-")
+        {
+            return false;
+        }
+        else
+        {
+            options.paths.push_back(argv[i]);
+        }
+    }
+    if (types) options.filter.types = types;
+    if (!options.paths.empty()) options.path = options.paths.front();
+    if (options.paths.size() > 1 && !options.summary) return false;
+    // The output of a command is parsed as it is written, as a stream, and named after the command in messages
+    if (options.command)
+    {
+        if (options.path || options.follow || options.index) return false;
+        options.path = options.command[0];
+        options.stream = true;
+    }
+    else if (options.teePath)
+    {
+        return false;
+    }
+    // The diagnostics of both logs are known once they are parsed whole
+    if (options.baselinePath ? options.stream || options.group || options.index || options.dedupe : !options.stripPrefixes.empty()) return false;
+    // Groups are laid out as indented text, the statistics are those of the built-in rules
+    if (options.path == nullptr || (options.group && options.format != OutputFormat::text) || (options.stats && options.rulesPath)) return false;
+    // A summary is text and counts every diagnostic of its logs
+    if (options.summary) return !options.baselinePath && !options.index && !options.stream && !options.dedupe && options.format == OutputFormat::text;
+    // The index is kept next to a log file and holds single diagnostics
+    if (options.index) return std::string_view(options.path) != "-" && !options.stream && !options.group && !options.dedupe;
+    // The views of a stream do not outlive their line
+    return !(options.dedupe && (options.stream || options.group));
+}
+
+// Lines are parsed from buffers of log-parser (private mappings, read buffers, decompressed blocks), so colors are stripped in place
+std::string_view StripEscapes(std::string_view line)
+{
+    return line.substr(0, StripCompilerOutputEscapes(const_cast<char*>(line.data()), line.size()));
+}
+
+// Parser of the rules loaded by --rules
+struct RuntimeRulesParser
+{
+    static inline CompilerOutputRuntimeParser rules;
+
+    static CompilerOutputLineView Parse(std::string_view line) { return rules.Parse(line); }
+    static CompilerOutputLineView Parse(std::string_view line, const CompilerOutputFilter& filter) { return rules.Parse(line, filter); }
+};
+
+// Parser applying --type and --file-prefix while lines are classified
+template <typename Parser>
+struct FilteredParser
+{
+    static inline CompilerOutputFilter filter;
+
+    static CompilerOutputLineView Parse(std::string_view line) { return Parser::Parse(line, filter); }
+};
+
+bool LoadRules(const char* path, uint64_t& rulesHash)
+{
+    LogFile file;
+    if (!file.Open(path))
+    {
+        fprintf(stderr, "Error opening file  %s : %s\n", path, strerror(errno));
+        return false;
+    }
+    // Never 0, which stands for the built-in rules
+    rulesHash = compiler_output_parser_detail::HashBytes(compiler_output_parser_detail::hashSeed, file.Data()) | 1;
+    std::string error;
+    if (!RuntimeRulesParser::rules.LoadCodeBlocksXml(file.Data(), error))
+    {
+        fprintf(stderr, "Error loading rules  %s : %s\n", path, error.c_str());
+        return false;
+    }
+    RuntimeRulesParser::rules.MapRuleNames(GetCompilerOutputRuleName);
+    return true;
+}
+
+// Calls onDiagnostic(view, lineIndex) for the lines that are not normal, returns the number of lines
+template <typename Parser, typename OnDiagnostic>
+uint64_t ParseLines(std::string_view data, OnDiagnostic&& onDiagnostic)
+{
+    uint64_t lineIndex = 0;
+    // Most logs have no colors at all, one scan saves looking at each line
+    const bool hasEscapes = HasCompilerOutputEscapes(data);
+    ForEachCompilerOutputLine(data,
+                              [&](std::string_view line)
+                              {
+                                  if (hasEscapes) line = StripEscapes(line);
+                                  const CompilerOutputLineView compilerOutputLineView = Parser::Parse(line);
+                                  if (compilerOutputLineView.type != CompilerOutputLineType::normal)
+                                  {
+                                      onDiagnostic(compilerOutputLineView, lineIndex);
+                                  }
+                                  ++lineIndex;
+                              });
+    return lineIndex;
+}
+
+template <typename Parser>
+void ParseLines(std::string_view data, std::vector<CompilerOutputLineView>& compilerOutputLineViews)
+{
+    ParseLines<Parser>(data, [&](const CompilerOutputLineView& view, uint64_t) { compilerOutputLineViews.push_back(view); });
+}
+
+// Log line numbers start at 1, returns the number of lines
+template <typename Parser>
+uint64_t ParseLines(std::string_view data, CompilerOutputDeduplicator& deduplicator)
+{
+    return ParseLines<Parser>(data, [&](const CompilerOutputLineView& view, uint64_t lineIndex) { deduplicator.Add(view, lineIndex + 1); });
+}
+
+// Same result as ParseLines, chunks are parsed concurrently and their results appended in log order
+template <typename Parser>
+void ParseLinesParallel(std::string_view data, unsigned jobs, std::vector<CompilerOutputLineView>& compilerOutputLineViews)
+{
+    const std::vector<std::string_view> chunks = SplitIntoChunks(data, parallelChunkSize);
+    std::vector<std::vector<CompilerOutputLineView>> chunkViews(chunks.size());
+    ParallelFor(chunks.size(), jobs, [&](unsigned, size_t chunkIndex) { ParseLines<Parser>(chunks[chunkIndex], chunkViews[chunkIndex]); });
+    size_t count = 0;
+    for (const std::vector<CompilerOutputLineView>& views : chunkViews) count += views.size();
+    compilerOutputLineViews.reserve(count);
+    for (const std::vector<CompilerOutputLineView>& views : chunkViews)
+    {
+        compilerOutputLineViews.insert(compilerOutputLineViews.end(), views.begin(), views.end());
+    }
+}
+
+// Each chunk is deduplicated on its own, then merged in log order with its line numbers moved after those of the chunks before it
+template <typename Parser>
+uint64_t ParseLinesParallel(std::string_view data, unsigned jobs, CompilerOutputDeduplicator& deduplicator)
+{
+    const std::vector<std::string_view> chunks = SplitIntoChunks(data, parallelChunkSize);
+    std::vector<CompilerOutputDeduplicator> chunkDeduplicators(chunks.size());
+    std::vector<uint64_t> chunkLineCounts(chunks.size());
+    ParallelFor(chunks.size(), jobs,
+                [&](unsigned, size_t chunkIndex)
+                {
+                    CompilerOutputDeduplicator& chunkDeduplicator = chunkDeduplicators[chunkIndex];
+                    chunkLineCounts[chunkIndex] = ParseLines<Parser>(chunks[chunkIndex],
+                                                                     [&](const CompilerOutputLineView& view, uint64_t lineIndex)
+                                                                     { chunkDeduplicator.Add(view, lineIndex + 1); });
+                });
+    uint64_t lineOffset = 0;
+    for (size_t chunkIndex = 0; chunkIndex < chunks.size(); ++chunkIndex)
+    {
+        deduplicator.Merge(chunkDeduplicators[chunkIndex], lineOffset);
+        lineOffset += chunkLineCounts[chunkIndex];
+    }
+    return lineOffset;
+}
+
+void PrintStats(const CompilerOutputStatsTable& stats)
+{
+    fprintf(stderr, "%-48s %12s %12s %12s %10s\n", "Rule", "Hits", "Rejections", "Time (ms)", "ns/try");
+    for (size_t rule = 0; rule < stats.size(); ++rule)
+    {
+        const CompilerOutputRuleStats& ruleStats = stats[rule];
+        const uint64_t attempts = ruleStats.hits + ruleStats.rejections;
+        if (!attempts) continue;
+        fprintf(stderr, "%-48s %12llu %12llu %12.3f %10.1f\n", GetCompilerOutputRuleName(static_cast<CompilerOutputRule>(rule)),
+                static_cast<unsigned long long>(ruleStats.hits), static_cast<unsigned long long>(ruleStats.rejections),
+                static_cast<double>(ruleStats.nanoseconds) / 1e6, static_cast<double>(ruleStats.nanoseconds) / static_cast<double>(attempts));
+    }
+}
+
+void WriteIndented(std::string_view indent, std::string_view line, DiagnosticWriter& writer)
+{
+    writer.WriteRaw(indent);
+    writer.WriteRaw(line);
+    writer.WriteRaw("\n");
+}
+
+void PrintCompilerOutputDiagnostic(const CompilerOutputDiagnostic& diagnostic, std::string_view indent, DiagnosticWriter& writer)
+{
+    writer.WriteRaw(indent);
+    writer.Write(diagnostic.View());
+    for (const std::string& quotedLine : diagnostic.quotedLines) WriteIndented(indent, quotedLine, writer);
+}
+
+// The primary diagnostic first, then the lines around it in log order
+void PrintCompilerOutputDiagnosticGroup(const CompilerOutputDiagnosticGroup& group, DiagnosticWriter& writer)
+{
+    const bool hasPrimary = group.primary.type != CompilerOutputLineType::normal;
+    if (hasPrimary) PrintCompilerOutputDiagnostic(group.primary, "", writer);
+    const std::string_view indent = hasPrimary ? "    " : "";
+    for (const std::string& includedFrom : group.includedFrom) WriteIndented(indent, includedFrom, writer);
+    for (const CompilerOutputDiagnostic& context : group.context) PrintCompilerOutputDiagnostic(context, indent, writer);
+    for (const CompilerOutputDiagnostic& note : group.notes) PrintCompilerOutputDiagnostic(note, indent, writer);
+}
+
+// Prints diagnostic groups as soon as they are complete, returns 1 once maxErrors errors were seen
+template <typename Parser, typename Stream>
+int PrintGroups(Stream& logStream, const Options& options, DiagnosticWriter& writer)
+{
+    CompilerOutputGrouper grouper;
+    CompilerOutputDiagnosticGroup group;
+    size_t errorCount = 0;
+    const bool limitErrors = options.maxErrors > 0;
+    auto print = [&]()
+    {
+        // Groups are filtered on their diagnostic, the parse has to see the notes and context lines of every group
+        if ((limitErrors && errorCount >= options.maxErrors) || !options.filter.Selects(group.primary.View())) return;
+        PrintCompilerOutputDiagnosticGroup(group, writer);
+        if (group.primary.type == CompilerOutputLineType::error) ++errorCount;
+    };
+    auto onLine = [&](std::string_view line)
+    {
+        line = StripEscapes(line);
+        if (grouper.Add(line, Parser::Parse(line), group)) print();
+    };
+    while (logStream.ReadLines(onLine))
+    {
+        writer.Flush();
+        if (limitErrors && errorCount >= options.maxErrors) return 1;
+    }
+    if (grouper.Finish(group)) print();
+    writer.Flush();
+    if (logStream.Error())
+    {
+        fprintf(stderr, "Error reading file  %s : %s\n", options.path, strerror(logStream.Error()));
+        return -1;
+    }
+    return limitErrors && errorCount >= options.maxErrors ? 1 : 0;
+}
+
+// Prints diagnostics as their lines come in, returns 1 once maxErrors errors were seen
+template <typename Parser, typename Stream>
+int ParseStream(Stream& logStream, const Options& options, DiagnosticWriter& writer)
+{
+    size_t errorCount = 0;
+    const bool limitErrors = options.maxErrors > 0;
+    auto onLine = [&](std::string_view line)
+    {
+        if (limitErrors && errorCount >= options.maxErrors) return;
+        const CompilerOutputLineView compilerOutputLineView = Parser::Parse(StripEscapes(line));
+        if (compilerOutputLineView.type == CompilerOutputLineType::normal) return;
+        writer.Write(compilerOutputLineView);
+        if (compilerOutputLineView.type == CompilerOutputLineType::error) ++errorCount;
+    };
+    while (logStream.ReadLines(onLine))
+    {
+        writer.Flush();
+        if (limitErrors && errorCount >= options.maxErrors) return 1;
+    }
+    writer.Flush();
+    if (logStream.Error())
+    {
+        fprintf(stderr, "Error reading file  %s : %s\n", options.path, strerror(logStream.Error()));
+        return -1;
+    }
+    return limitErrors && errorCount >= options.maxErrors ? 1 : 0;
+}
+
+template <typename Parser>
+uint64_t ParseLines(std::string_view data, const Options& options, CompilerOutputDeduplicator& deduplicator)
+{
+    return options.jobs > 1 ? ParseLinesParallel<Parser>(data, options.jobs, deduplicator) : ParseLines<Parser>(data, deduplicator);
+}
+
+int PrintUniqueLines(const CompilerOutputDeduplicator& deduplicator, const Options& options, DiagnosticWriter& writer)
 {
-    if (argc < 2)
+    size_t errorCount = 0;
+    for (const CompilerOutputUniqueLine& uniqueLine : deduplicator.Lines())
     {
-        fprintf(stderr, "Usage %s <log file>\n", argv[0]);
+        writer.Write(uniqueLine.view, {.count = uniqueLine.count, .firstLogLine = uniqueLine.firstLine, .lastLogLine = uniqueLine.lastLine});
+        if (uniqueLine.view.type == CompilerOutputLineType::error && ++errorCount == options.maxErrors) return 1;
+    }
+    return 0;
+}
+
+// Prints the diagnostics of data, returns 1 once errorCount reaches maxErrors
+template <typename Parser>
+int PrintDiagnostics(std::string_view data, const Options& options, DiagnosticWriter& writer, size_t& errorCount)
+{
+    // The views point into data, which outlives them
+    std::vector<CompilerOutputLineView> compilerOutputLineViews;
+    if (options.jobs > 1)
+    {
+        ParseLinesParallel<Parser>(data, options.jobs, compilerOutputLineViews);
+    }
+    else
+    {
+        ParseLines<Parser>(data, compilerOutputLineViews);
+    }
+    for (const CompilerOutputLineView& compilerOutputLineView : compilerOutputLineViews)
+    {
+        writer.Write(compilerOutputLineView);
+        if (compilerOutputLineView.type == CompilerOutputLineType::error && ++errorCount == options.maxErrors) return 1;
+    }
+    return 0;
+}
+
+// Each block is parsed while the next one is decompressed, output is the same as for the decompressed log
+template <typename Parser>
+int ParseCompressedLog(std::string_view data, LogCompression compression, const Options& options, DiagnosticWriter& writer)
+{
+    if (!IsLogCompressionSupported(compression))
+    {
+        fprintf(stderr, "%s is %s compressed, which this build of log-parser cannot read\n", options.path, GetLogCompressionName(compression));
         return -1;
     }
-    std::ifstream stream(argv[1]);
-    if (!stream.good())
+    CompressedLogStream logStream(data, compression);
+    int status = 0;
+    if (options.group)
+    {
+        status = PrintGroups<Parser>(logStream, options, writer);
+    }
+    else if (options.stream)
+    {
+        status = ParseStream<Parser>(logStream, options, writer);
+    }
+    else if (options.dedupe)
+    {
+        // The unique lines point into the blocks they were first seen in
+        logStream.KeepBlocks();
+        CompilerOutputDeduplicator deduplicator;
+        uint64_t lineOffset = 0;
+        std::string_view lines;
+        while (logStream.ReadBlock(lines))
+        {
+            CompilerOutputDeduplicator blockDeduplicator;
+            const uint64_t lineCount = ParseLines<Parser>(lines, options, blockDeduplicator);
+            deduplicator.Merge(blockDeduplicator, lineOffset);
+            lineOffset += lineCount;
+        }
+        if (!logStream.Error()) status = PrintUniqueLines(deduplicator, options, writer);
+    }
+    else
     {
-        fprintf(stderr, "Error opening file  %s : %s\n", argv[0], strerror(errno));
+        size_t errorCount = 0;
+        std::string_view lines;
+        while (status == 0 && logStream.ReadBlock(lines)) status = PrintDiagnostics<Parser>(lines, options, writer, errorCount);
+    }
+    if (logStream.Error())
+    {
+        fprintf(stderr, "Error reading file  %s : %s\n", options.path, strerror(logStream.Error()));
         return -1;
     }
+    return status;
+}
 
-    std::vector<CompilerOutputLineInfo> compilerOutputLineInfos;
-    std::string line;
-    while (std::getline(stream, line))
+// Same as ParseLines with options.jobs threads, onDiagnostic is called on this thread in log order
+template <typename Parser, typename OnDiagnostic>
+uint64_t ParseLinesInOrder(std::string_view data, const Options& options, OnDiagnostic&& onDiagnostic)
+{
+    if (options.jobs <= 1) return ParseLines<Parser>(data, onDiagnostic);
+    const std::vector<std::string_view> chunks = SplitIntoChunks(data, parallelChunkSize);
+    std::vector<std::vector<std::pair<CompilerOutputLineView, uint64_t>>> chunkViews(chunks.size());
+    std::vector<uint64_t> chunkLineCounts(chunks.size());
+    ParallelFor(chunks.size(), options.jobs,
+                [&](unsigned, size_t chunkIndex)
+                {
+                    std::vector<std::pair<CompilerOutputLineView, uint64_t>>& views = chunkViews[chunkIndex];
+                    chunkLineCounts[chunkIndex] = ParseLines<Parser>(chunks[chunkIndex],
+                                                                     [&](const CompilerOutputLineView& view, uint64_t lineIndex)
+                                                                     { views.emplace_back(view, lineIndex); });
+                });
+    uint64_t lineOffset = 0;
+    for (size_t chunkIndex = 0; chunkIndex < chunks.size(); ++chunkIndex)
+    {
+        for (const auto& [view, lineIndex] : chunkViews[chunkIndex]) onDiagnostic(view, lineOffset + lineIndex);
+        lineOffset += chunkLineCounts[chunkIndex];
+    }
+    return lineOffset;
+}
+
+// Adds the diagnostics of data to segment, returns the number of lines
+template <typename Parser>
+uint64_t IndexLines(std::string_view data, const Options& options, uint64_t firstLogLine, LogIndexSegment& segment)
+{
+    return ParseLinesInOrder<Parser>(data, options,
+                                     [&](const CompilerOutputLineView& view, uint64_t lineIndex) { segment.Add(view, firstLogLine + lineIndex); });
+}
+
+// Calls onDiagnostic(view, logLine) for the diagnostics of the log at path, compressed or not, in log order
+template <typename Parser, typename OnDiagnostic>
+int ForEachLogDiagnostic(const char* path, const Options& options, OnDiagnostic&& onDiagnostic)
+{
+    LogFile logFile;
+    if (!logFile.Open(path))
     {
-        CompilerOutputLineInfo compilerOutputLineInfo = GetCompilerOutputLineInfo(line);
-        if (compilerOutputLineInfo.type != CompilerOutputLineType::normal)
+        fprintf(stderr, "Error opening file  %s : %s\n", path, strerror(errno));
+        return -1;
+    }
+    const LogCompression compression = DetectLogCompression(logFile.Data());
+    if (compression == LogCompression::none)
+    {
+        ParseLinesInOrder<Parser>(logFile.Data(), options,
+                                  [&](const CompilerOutputLineView& view, uint64_t lineIndex) { onDiagnostic(view, lineIndex + 1); });
+        return 0;
+    }
+    if (!IsLogCompressionSupported(compression))
+    {
+        fprintf(stderr, "%s is %s compressed, which this build of log-parser cannot read\n", path, GetLogCompressionName(compression));
+        return -1;
+    }
+    CompressedLogStream logStream(logFile.Data(), compression);
+    uint64_t firstLogLine = 1;
+    std::string_view lines;
+    while (logStream.ReadBlock(lines))
+    {
+        firstLogLine += ParseLinesInOrder<Parser>(lines, options,
+                                                  [&](const CompilerOutputLineView& view, uint64_t lineIndex)
+                                                  { onDiagnostic(view, firstLogLine + lineIndex); });
+    }
+    if (logStream.Error())
+    {
+        fprintf(stderr, "Error reading file  %s : %s\n", path, strerror(logStream.Error()));
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Prints the diagnostics of the log that the baseline log does not have, each the first time it is seen. Returns 1 when
+ * one of them is an error or a warning, so that a new warning fails a merge check.
+ */
+template <typename Parser>
+int PrintNewDiagnostics(const Options& options, DiagnosticWriter& writer)
+{
+    CompilerOutputFingerprintSet fingerprints;
+    for (std::string_view prefix : options.stripPrefixes) fingerprints.AddPathPrefix(prefix);
+    int status = ForEachLogDiagnostic<Parser>(options.baselinePath, options, [&](const CompilerOutputLineView& view, uint64_t)
+                                              { fingerprints.Insert(fingerprints.Fingerprint(view)); });
+    if (status != 0) return status;
+    size_t errorCount = 0;
+    bool stopped = false;
+    bool failed = false;
+    status = ForEachLogDiagnostic<Parser>(options.path, options,
+                                          [&](const CompilerOutputLineView& view, uint64_t logLine)
+                                          {
+                                              if (stopped || !fingerprints.Insert(fingerprints.Fingerprint(view))) return;
+                                              writer.Write(view, {.logLine = logLine});
+                                              failed |= view.type == CompilerOutputLineType::error || view.type == CompilerOutputLineType::warning;
+                                              if (view.type == CompilerOutputLineType::error && ++errorCount == options.maxErrors) stopped = true;
+                                          });
+    return status != 0 ? status : failed ? 1 : 0;
+}
+
+// Updates the index with what was appended to the log since the last run, then prints the diagnostics of the index
+template <typename Parser>
+int PrintIndexedDiagnostics(const Options& options, DiagnosticWriter& writer)
+{
+    const std::string indexPath = std::string(options.path) + ".idx";
+    LogIndex index;
+    LogFile logFile;
+    // The last line when the log does not end with '\n', left out of the index as it may still grow but printed
+    std::string_view unterminatedLine;
+    if (logFile.Open(options.path))
+    {
+        if (DetectLogCompression(logFile.Data()) != LogCompression::none)
+        {
+            fprintf(stderr, "%s is compressed, --index needs a log that can be appended to\n", options.path);
+            return -1;
+        }
+        auto parse = [&options](std::string_view lines, uint64_t firstLogLine, LogIndexSegment& segment)
+        { return IndexLines<Parser>(lines, options, firstLogLine, segment); };
+        if (!UpdateLogIndex(indexPath.c_str(), logFile.Data(), options.rulesHash, index, parse))
         {
-            compilerOutputLineInfos.push_back(std::move(compilerOutputLineInfo));
+            fprintf(stderr, "Error writing index  %s : %s\n", indexPath.c_str(), strerror(errno));
+            return -1;
         }
+        unterminatedLine = logFile.Data().substr(index.Header().parsedSize);
     }
-    stream.close();
-    for (const CompilerOutputLineInfo& compilerOutputLineInfo : compilerOutputLineInfos)
+    else
     {
-        const char* type;
-        switch (compilerOutputLineInfo.type)
+        // The index still answers for a log that is gone
+        const int logErrno = errno;
+        if (!index.Open(indexPath.c_str()))
         {
-            case CompilerOutputLineType::warning:
-                type = "WARNING :";
-                break;
-            case CompilerOutputLineType::error:
-                type = "ERROR :";
-                break;
-            case CompilerOutputLineType::info:
-                type = "INFO :";
-                break;
-            default:
-                type = "UNKNOWN :";
-                break;
+            fprintf(stderr, "Error opening file  %s : %s\n", options.path, strerror(logErrno));
+            return -1;
         }
-        printf("%s ", type);
-        if (!compilerOutputLineInfo.fileName.empty())
+        if (index.Header().rulesHash != options.rulesHash)
+        {
+            fprintf(stderr, "%s was indexed with other rules and %s is gone\n", indexPath.c_str(), options.path);
+            return -1;
+        }
+    }
+
+    // File names are matched once each rather than once per diagnostic
+    std::vector<bool> fileSelected(index.FileNames().size(), true);
+    const std::string_view filePrefix = options.filter.filePrefix;
+    if (!filePrefix.empty())
+    {
+        for (size_t id = 0; id < fileSelected.size(); ++id) fileSelected[id] = index.FileNames()[id].starts_with(filePrefix);
+    }
+    size_t errorCount = 0;
+    int status = 0;
+    index.ForEach(
+        [&](const LogIndexRecord& record, const CompilerOutputLineView& view)
+        {
+            if (status != 0 || !options.filter.SelectsType(view.type)) return;
+            if (!filePrefix.empty() && (record.fileName == LogIndexRecord::noFileName || !fileSelected[record.fileName])) return;
+            writer.Write(view, {.logLine = record.logLine});
+            if (view.type == CompilerOutputLineType::error && ++errorCount == options.maxErrors) status = 1;
+        });
+    if (status != 0 || unterminatedLine.empty()) return status;
+    ParseLines<Parser>(unterminatedLine,
+                       [&](const CompilerOutputLineView& view, uint64_t)
+                       {
+                           if (!options.filter.Selects(view)) return;
+                           writer.Write(view, {.logLine = index.Header().lineCount + 1});
+                           if (view.type == CompilerOutputLineType::error && ++errorCount == options.maxErrors) status = 1;
+                       });
+    return status;
+}
+
+// The logs of paths, directories are walked for their regular files, leaving out the .idx files of --index
+bool CollectLogs(const std::vector<const char*>& paths, std::vector<std::string>& logs)
+{
+    namespace fs = std::filesystem;
+    for (const char* path : paths)
+    {
+        std::error_code error;
+        if (std::string_view(path) == "-" || !fs::is_directory(path, error))
         {
-            if (compilerOutputLineInfo.fileName.at(0) == '/')
-            {
-                printf("file://%s ", compilerOutputLineInfo.fileName.c_str());
-            }
-            else
-            {
-                printf("%s", compilerOutputLineInfo.fileName.c_str());
-            }
-            if (!compilerOutputLineInfo.line.empty())
-            {
-                printf(":%s ", compilerOutputLineInfo.line.c_str());
-            }
+            logs.emplace_back(path);
+            continue;
         }
-        if (!compilerOutputLineInfo.message.empty())
+        const size_t firstLog = logs.size();
+        for (fs::recursive_directory_iterator it(path, error), end; !error && it != end; it.increment(error))
         {
-            printf("%s\n", compilerOutputLineInfo.message.c_str());
+            if (it->is_regular_file(error) && it->path().extension() != ".idx") logs.push_back(it->path().string());
         }
+        if (error)
+        {
+            fprintf(stderr, "Error reading directory  %s : %s\n", path, error.message().c_str());
+            return false;
+        }
+        // In the same order whatever the order of the directory entries
+        std::sort(logs.begin() + static_cast<std::ptrdiff_t>(firstLog), logs.end());
+    }
+    return true;
+}
+
+void PrintSummary(const CompilerOutputSummary& summary, size_t logCount, size_t top)
+{
+    printf("%12zu  logs\n%12llu  errors\n%12llu  warnings\n%12llu  infos\n%12zu  files\n", logCount,
+           static_cast<unsigned long long>(summary.Count(CompilerOutputLineType::error)),
+           static_cast<unsigned long long>(summary.Count(CompilerOutputLineType::warning)),
+           static_cast<unsigned long long>(summary.Count(CompilerOutputLineType::info)), summary.FileCount());
+    printf("\n%12s  %s\n", "Diagnostics", "Rule");
+    for (size_t rule = 1; rule < compilerOutputRuleCount; ++rule)
+    {
+        const uint64_t count = summary.Count(static_cast<CompilerOutputRule>(rule));
+        if (count) printf("%12llu  %s\n", static_cast<unsigned long long>(count), GetCompilerOutputRuleName(static_cast<CompilerOutputRule>(rule)));
+    }
+    // Rules loaded with --rules that have no built-in name
+    if (summary.Count(CompilerOutputRule::none)) printf("%12llu  Other\n", static_cast<unsigned long long>(summary.Count(CompilerOutputRule::none)));
+    if (top == 0) return;
+    printf("\n%12s %12s %12s  %s\n", "Errors", "Warnings", "Infos", "File");
+    for (const auto& [fileName, counts] : summary.TopFiles(top))
+    {
+        printf("%12llu %12llu %12llu  %.*s\n", static_cast<unsigned long long>(counts.errors), static_cast<unsigned long long>(counts.warnings),
+               static_cast<unsigned long long>(counts.infos), static_cast<int>(fileName.size()), fileName.data());
+    }
+    printf("\n%12s  %s\n", "Warnings", "Warning");
+    for (const auto& [warning, count] : summary.TopWarnings(top))
+    {
+        printf("%12llu  %.*s\n", static_cast<unsigned long long>(count), static_cast<int>(warning.size()), warning.data());
+    }
+}
+
+/*
+ * Parses the logs on options.jobs threads, a log at a time each, into a summary per thread, which are added up at the
+ * end. A single log is parsed by all the threads instead.
+ */
+template <typename Parser>
+int SummarizeLogs(const Options& options)
+{
+    std::vector<std::string> logs;
+    if (!CollectLogs(options.paths, logs)) return -1;
+    Options logOptions = options;
+    if (logs.size() > 1) logOptions.jobs = 1;
+    std::vector<CompilerOutputSummary> summaries(std::max(options.jobs, 1u));
+    std::atomic<bool> failed{false};
+    ParallelFor(logs.size(), logs.size() > 1 ? options.jobs : 1,
+                [&](unsigned threadIndex, size_t logIndex)
+                {
+                    CompilerOutputSummary& summary = summaries[threadIndex];
+                    auto add = [&summary](const CompilerOutputLineView& view, uint64_t) { summary.Add(view); };
+                    if (ForEachLogDiagnostic<Parser>(logs[logIndex].c_str(), logOptions, add) != 0) failed = true;
+                });
+    for (size_t threadIndex = 1; threadIndex < summaries.size(); ++threadIndex) summaries[0].Merge(summaries[threadIndex]);
+    PrintSummary(summaries[0], logs.size(), options.top);
+    return failed ? -1 : 0;
+}
+
+// Runs the command of the build-wrapper mode, returns the exit status of the command unless parsing failed or stopped it
+template <typename Parser>
+int RunBuildCommand(const Options& options, DiagnosticWriter& writer)
+{
+    int passthroughFd = STDERR_FILENO;
+    if (options.teePath)
+    {
+        passthroughFd = open(options.teePath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        if (passthroughFd < 0)
+        {
+            fprintf(stderr, "Error opening file  %s : %s\n", options.teePath, strerror(errno));
+            return -1;
+        }
+    }
+    int status = -1;
+    {
+        BuildCommand command;
+        if (command.Start(options.command, passthroughFd))
+        {
+            status = options.group ? PrintGroups<Parser>(command, options, writer) : ParseStream<Parser>(command, options, writer);
+            // Past --max-errors, or when its output cannot be read, the build is stopped rather than waited for
+            if (status == 0) status = command.Wait();
+            else command.Stop();
+        }
+        else
+        {
+            fprintf(stderr, "Error running  %s : %s\n", options.path, strerror(errno));
+        }
+    }
+    if (passthroughFd != STDERR_FILENO) close(passthroughFd);
+    return status;
+}
+
+template <typename Parser>
+int ParseLog(const Options& options, DiagnosticWriter& writer)
+{
+    if (options.command)
+    {
+        return RunBuildCommand<Parser>(options, writer);
+    }
+    if (options.baselinePath)
+    {
+        return PrintNewDiagnostics<Parser>(options, writer);
+    }
+    if (options.summary)
+    {
+        return SummarizeLogs<Parser>(options);
+    }
+    if (options.index)
+    {
+        return PrintIndexedDiagnostics<Parser>(options, writer);
+    }
+    // Reading stdin whole would hold up a stream, so a stream only looks for compression in files
+    const bool streamed = options.group || options.stream;
+    LogFile logFile;
+    if (!streamed || DetectLogCompression(options.path) != LogCompression::none)
+    {
+        if (!logFile.Open(options.path))
+        {
+            fprintf(stderr, "Error opening file  %s : %s\n", options.path, strerror(errno));
+            return -1;
+        }
+        const LogCompression compression = DetectLogCompression(logFile.Data());
+        if (compression != LogCompression::none) return ParseCompressedLog<Parser>(logFile.Data(), compression, options, writer);
+    }
+
+    if (streamed)
+    {
+        LogStream logStream(options.follow);
+        if (!logStream.Open(options.path))
+        {
+            fprintf(stderr, "Error opening file  %s : %s\n", options.path, strerror(errno));
+            return -1;
+        }
+        return options.group ? PrintGroups<Parser>(logStream, options, writer) : ParseStream<Parser>(logStream, options, writer);
+    }
+
+    if (options.dedupe)
+    {
+        CompilerOutputDeduplicator deduplicator;
+        ParseLines<Parser>(logFile.Data(), options, deduplicator);
+        return PrintUniqueLines(deduplicator, options, writer);
+    }
+
+    size_t errorCount = 0;
+    return PrintDiagnostics<Parser>(logFile.Data(), options, writer, errorCount);
+}
+
+// The index keeps every diagnostic and is filtered when it is printed, groups are filtered on their diagnostic
+template <typename Parser>
+int ParseFilteredLog(const Options& options, DiagnosticWriter& writer)
+{
+    if (options.filter.IsEmpty() || options.index || options.group) return ParseLog<Parser>(options, writer);
+    FilteredParser<Parser>::filter = options.filter;
+    return ParseLog<FilteredParser<Parser>>(options, writer);
+}
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        PrintUsage(argv[0]);
+        return -1;
+    }
+    // Closed with End() whatever ParseLog returns, so that a SARIF log is complete even when parsing stopped early
+    if (options.rulesPath && !LoadRules(options.rulesPath, options.rulesHash)) return -1;
+    DiagnosticWriter writer(options.format, stdout);
+    if (options.rulesPath)
+    {
+        std::vector<std::string> names;
+        for (const CompilerOutputRuntimeRule& rule : RuntimeRulesParser::rules.Rules()) names.push_back(rule.name);
+        writer.SetRuntimeRuleNames(std::move(names));
+    }
+    writer.Begin();
+    if (options.rulesPath)
+    {
+        const int status = ParseFilteredLog<RuntimeRulesParser>(options, writer);
+        writer.End();
+        return status;
+    }
+    if (!options.stats)
+    {
+        const int status = ParseFilteredLog<CompilerOutputParser<>>(options, writer);
+        writer.End();
+        return status;
     }
+    using StatsParser = CompilerOutputParser<CompilerOutputToolchain::all, DefaultCompilerOutputRuleSet, CompilerOutputStats>;
+    const int status = ParseFilteredLog<StatsParser>(options, writer);
+    writer.End();
+    PrintStats(CompilerOutputStats::Collect());
+    return status;
 }
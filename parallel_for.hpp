@@ -0,0 +1,51 @@
+/*
+ * Compiler Output Parser: Parse error, warning and messages
+ * Copyright (C) 2024  Christo Joseph
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PARALLEL_FOR_HPP_INCLUDED
+#define PARALLEL_FOR_HPP_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Number of threads for --jobs 0
+inline unsigned DefaultJobCount() { return std::max(1u, std::thread::hardware_concurrency()); }
+
+/*
+ * Runs task(threadIndex, taskIndex) for every taskIndex in [0, taskCount) on up to jobs threads. Threads take the next
+ * task as soon as they are done with the previous one, so a slow task does not hold up the others. The calling thread
+ * takes part as thread 0.
+ */
+template <typename Task>
+void ParallelFor(size_t taskCount, unsigned jobs, Task&& task)
+{
+    const unsigned threadCount = static_cast<unsigned>(std::min<size_t>(std::max(jobs, 1u), taskCount));
+    std::atomic<size_t> nextTask{0};
+    auto worker = [&](unsigned threadIndex)
+    {
+        for (size_t taskIndex = nextTask++; taskIndex < taskCount; taskIndex = nextTask++) task(threadIndex, taskIndex);
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount);
+    for (unsigned threadIndex = 1; threadIndex < threadCount; ++threadIndex) threads.emplace_back(worker, threadIndex);
+    if (threadCount > 0) worker(0);
+    for (std::thread& thread : threads) thread.join();
+}
+
+#endif  // PARALLEL_FOR_HPP_INCLUDED
@@ -16,7 +16,16 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cstddef>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include "build_command.hpp"
 #include "compiler_output_parser.hpp"
+#include "compiler_output_runtime_rules.hpp"
+#include "compressed_log.hpp"
+#include "diagnostic_writer.hpp"
+#include "log_index.hpp"
 
 #define USE_GOOGLE_TESTS
 
@@ -146,6 +155,36 @@ TEST(Sanity, Handle_Large_String2)
     EXPECT_EQ(GetCompilerOutputLineInfo(testLine).type, CompilerOutputLineType::normal);
 }
 
+TEST(Sanity, Anchor_at_any_offset)
+{
+    for (size_t offset = 0; offset < 80; ++offset)
+    {
+        std::string testLine = std::string(offset, 'x') + " cc1: warning: command line option '-std=c++11' is valid for C++/ObjC++ but not for C";
+        EXPECT_EQ(GetCompilerOutputLineInfo(testLine).type, CompilerOutputLineType::warning) << "offset " << offset;
+        testLine = std::string(offset, 'x') + " : && :";
+        EXPECT_EQ(GetCompilerOutputLineInfo(testLine).type, CompilerOutputLineType::normal) << "offset " << offset;
+    }
+}
+
+TEST(Sanity, Diagnostic_after_long_prefix)
+{
+    std::string linkCommand = "/usr/bin/ld";
+    while (linkCommand.size() < 32 * 1024) linkCommand += " -L/home/user/build/tmp/sysroots/armv7/usr/lib/plugins";
+    CompilerOutputLineView view = GetCompilerOutputLineView(linkCommand + ": cannot find -lmagic");
+    EXPECT_EQ(view.rule, CompilerOutputRule::linkerErrorLibNotFound);
+    EXPECT_EQ(view.message, "cannot find -lmagic");
+
+    const std::string fileName = "/home/user/build/" + std::string(4096, 'd') + "/test.cpp";
+    view = GetCompilerOutputLineView(fileName + ":3:10: fatal error: test.h: No such file or directory");
+    EXPECT_EQ(view.rule, CompilerOutputRule::preprocessorError);
+    EXPECT_EQ(view.fileName, fileName);
+    EXPECT_EQ(view.line, 3u);
+
+    view = GetCompilerOutputLineView(std::string(4096, 'x') + " note: declared here");
+    EXPECT_EQ(view.rule, CompilerOutputRule::generalNote);
+    EXPECT_EQ(view.message, "note: declared here");
+}
+
 TEST(ErrorLine, Linker_error_lib_not_found)
 {
     std::string testLine = "/usr/bin/ld: cannot find -lmagic";
@@ -186,6 +225,624 @@ TEST(WarningLine, Preprocessor_warning)
     EXPECT_EQ(info.message, expected.message);
 }
 
+TEST(NoteLine, Compiler_note_colon_in_message)
+{
+    std::string testLine = "/home/test/src/a.cpp:12:5: note: candidate: 'void f(int)' declared at b.h:4:2: here";
+    CompilerOutputLineInfo info = GetCompilerOutputLineInfo(testLine);
+    EXPECT_EQ(info.type, CompilerOutputLineType::info);
+    EXPECT_EQ(info.fileName, "/home/test/src/a.cpp");
+    EXPECT_EQ(info.line, "12");
+    EXPECT_EQ(info.message, "note: candidate: 'void f(int)' declared at b.h:4:2: here");
+}
+
+TEST(ErrorLine, Undefined_reference_in_object)
+{
+    std::string testLine = "obj/Release/main.o:src/main.c:42: undefined reference to `foo'";
+    CompilerOutputLineInfo info = GetCompilerOutputLineInfo(testLine);
+    EXPECT_EQ(info.type, CompilerOutputLineType::error);
+    EXPECT_EQ(info.fileName, "src/main.c");
+    EXPECT_EQ(info.line, "42");
+    EXPECT_EQ(info.message, "undefined reference to `foo'");
+}
+
+TEST(LineView, Location_numbers_and_rule)
+{
+    std::string testLine = "/home/test/file/path/test.cpp:3:10: fatal error: test.h: No such file or directory";
+    CompilerOutputLineView view = GetCompilerOutputLineView(testLine);
+    static_assert(std::is_trivially_copyable_v<CompilerOutputLineView>);
+    EXPECT_EQ(view.type, CompilerOutputLineType::error);
+    EXPECT_EQ(view.rule, CompilerOutputRule::preprocessorError);
+    EXPECT_STREQ(GetCompilerOutputRuleName(view.rule), "Preprocessor error");
+    EXPECT_EQ(view.fileName, "/home/test/file/path/test.cpp");
+    EXPECT_EQ(view.line, 3u);
+    EXPECT_EQ(view.column, 10u);
+    EXPECT_EQ(view.message, "fatal error: test.h: No such file or directory");
+    EXPECT_EQ(view.fileName.data(), testLine.data());
+}
+
+TEST(LineView, No_location)
+{
+    std::string testLine = "/usr/bin/ld: cannot find -lmagic";
+    CompilerOutputLineView view = GetCompilerOutputLineView(testLine);
+    EXPECT_EQ(view.rule, CompilerOutputRule::linkerErrorLibNotFound);
+    EXPECT_EQ(view.line, CompilerOutputLineView::noNumber);
+    EXPECT_EQ(view.column, CompilerOutputLineView::noNumber);
+    EXPECT_EQ(MakeCompilerOutputLineInfo(view).line, "");
+}
+
+TEST(LineInfo, Strings_from_memory_resource)
+{
+    std::pmr::monotonic_buffer_resource arena;
+    std::pmr::vector<CompilerOutputPmrLineInfo> infos(&arena);
+    infos.push_back(GetCompilerOutputLineInfo("/home/test/file/path/test.cpp:3:10: fatal error: test.h: No such file or directory", &arena));
+    // Built from the default resource, moved into the arena by the vector
+    infos.emplace_back(GetCompilerOutputLineInfo("main.cpp:1234567: warning: unused variable 'x' in a message longer than SSO",
+                                                       std::pmr::get_default_resource()));
+    infos.emplace_back();
+    for (const CompilerOutputPmrLineInfo& info : infos) EXPECT_EQ(info.get_allocator().resource(), &arena);
+    EXPECT_EQ(infos[0].type, CompilerOutputLineType::error);
+    EXPECT_EQ(infos[0].fileName, "/home/test/file/path/test.cpp");
+    EXPECT_EQ(infos[0].line, "3");
+    EXPECT_EQ(infos[0].message, "fatal error: test.h: No such file or directory");
+    EXPECT_EQ(infos[1].line, "1234567");
+    EXPECT_EQ(infos[2].type, CompilerOutputLineType::normal);
+}
+
+TEST(RuleSet, Toolchain_selection)
+{
+    std::string testLine = "windres.exe: no resources";
+    EXPECT_EQ(GetCompilerOutputLineView(testLine).rule, CompilerOutputRule::resourceCompilerError2);
+    using GccBinutilsParser = CompilerOutputParser<CompilerOutputToolchain::gcc | CompilerOutputToolchain::binutils>;
+    EXPECT_EQ(GccBinutilsParser::Parse(testLine).type, CompilerOutputLineType::normal);
+    testLine = "/usr/bin/ld: cannot find -lmagic";
+    EXPECT_EQ(GccBinutilsParser::Parse(testLine).rule, CompilerOutputRule::linkerErrorLibNotFound);
+    EXPECT_EQ(CompilerOutputParser<CompilerOutputToolchain::gcc>::Parse(testLine).type, CompilerOutputLineType::normal);
+}
+
+TEST(Filter, Same_as_filtering_the_result)
+{
+    // Lines an excluded rule wins before a selected one could match them
+    const std::string lines[] = {"src/a.cpp:3:5: warning: unused variable 'x'",
+                                 "src/a.cpp:3:5: note: declared here",
+                                 "src/a.cpp:3:5: error: 'y' was not declared in this scope",
+                                 "/usr/include/c.h:1:2: error: #error no",
+                                 "src/a.cpp: In function 'int main()':",
+                                 "obj/a.o:src/a.cpp:12: undefined reference to `f()'",
+                                 "collect2: error: ld returned 1 exit status",
+                                 "[4/265] Building CXX object a.o"};
+    const CompilerOutputFilter filters[] = {{.types = CompilerOutputTypeBit(CompilerOutputLineType::error), .filePrefix = {}},
+                                            {.types = CompilerOutputTypeBit(CompilerOutputLineType::info), .filePrefix = {}},
+                                            {.types = CompilerOutputFilter::allTypes, .filePrefix = "src/"},
+                                            {.types = CompilerOutputTypeBit(CompilerOutputLineType::error), .filePrefix = "src/"}};
+    for (const CompilerOutputFilter& filter : filters)
+    {
+        for (const std::string& line : lines)
+        {
+            const CompilerOutputLineView view = GetCompilerOutputLineView(line);
+            const CompilerOutputLineView filtered = GetCompilerOutputLineView(line, filter);
+            EXPECT_EQ(filtered.rule, filter.Selects(view) ? view.rule : CompilerOutputRule::none) << line;
+            EXPECT_EQ(filtered.message, filter.Selects(view) ? view.message : std::string_view()) << line;
+        }
+    }
+}
+
+TEST(Stats, Hits_and_rejections)
+{
+    using StatsParser = CompilerOutputParser<CompilerOutputToolchain::all, DefaultCompilerOutputRuleSet, CompilerOutputStats>;
+    CompilerOutputStats::Reset();
+    EXPECT_EQ(StatsParser::Parse("/src/a.cpp:3: warning: unused variable 'x'").rule, CompilerOutputRule::compilerWarning);
+    EXPECT_EQ(StatsParser::Parse("[4/265] Building CXX object a.o").rule, CompilerOutputRule::none);
+    const CompilerOutputStatsTable stats = CompilerOutputStats::Collect();
+    EXPECT_EQ(stats[static_cast<size_t>(CompilerOutputRule::compilerWarning)].hits, 1u);
+    EXPECT_EQ(stats[static_cast<size_t>(CompilerOutputRule::preprocessorWarning)].rejections, 1u);
+    const CompilerOutputRuleStats& notTried = stats[static_cast<size_t>(CompilerOutputRule::compilerError)];
+    EXPECT_EQ(notTried.hits + notTried.rejections, 0u);
+    EXPECT_EQ(stats[static_cast<size_t>(CompilerOutputRule::none)].hits, 1u);
+}
+
+TEST(Batch, Columns_and_file_table)
+{
+    std::string buffer =
+        "[1/3] Building CXX object a.o\r\n"
+        "/src/a.h:10:3: warning: unused parameter 'x' [-Wunused-parameter]\n"
+        "/src/b.cpp:7:1: error: expected ';' before '}' token\n"
+        "/src/a.h:10:3: warning: unused parameter 'x' [-Wunused-parameter]\r\n"
+        "collect2: error: ld returned 1 exit status";
+    CompilerOutputBatch batch = ParseCompilerOutput(buffer);
+    ASSERT_EQ(batch.Size(), 4u);
+    EXPECT_EQ(batch.files.Size(), 2u);
+    EXPECT_EQ(batch.fileIds[0], batch.fileIds[2]);
+    EXPECT_EQ(batch.files.Name(batch.fileIds[1]), "/src/b.cpp");
+    EXPECT_EQ(batch.fileIds[3], CompilerOutputFileTable::noFile);
+    EXPECT_EQ(batch.types[1], CompilerOutputLineType::error);
+    EXPECT_EQ(batch.rules[3], CompilerOutputRule::generalError);
+    EXPECT_EQ(batch.lines[1], 7u);
+    EXPECT_EQ(batch.columns[1], 1u);
+    EXPECT_EQ(batch.View(2, buffer).message, "warning: unused parameter 'x' [-Wunused-parameter]");
+    EXPECT_EQ(batch.View(3, buffer).message, "error: ld returned 1 exit status");
+}
+
+TEST(Dedupe, Counts_and_log_lines)
+{
+    const std::string lines[] = {"/src/a.h:10:3: warning: 'f' is deprecated [-Wdeprecated-declarations]",
+                                 "/src/a.h:10:3: warning: 'f' is  deprecated [-Wdeprecated-declarations] ",
+                                 "/src/a.h:10:4: warning: 'f' is deprecated [-Wdeprecated-declarations]",
+                                 "/src/a.h:10:3: warning: 'f' is deprecated [-Wdeprecated-declarations]"};
+    CompilerOutputDeduplicator first;
+    EXPECT_TRUE(first.Add(GetCompilerOutputLineView(lines[0]), 1));
+    EXPECT_FALSE(first.Add(GetCompilerOutputLineView(lines[1]), 2));
+    EXPECT_TRUE(first.Add(GetCompilerOutputLineView(lines[2]), 3));
+    CompilerOutputDeduplicator second;
+    second.Add(GetCompilerOutputLineView(lines[3]), 5);
+    first.Merge(second, 100);
+    ASSERT_EQ(first.Size(), 2u);
+    const CompilerOutputUniqueLine& unique = first.Lines()[0];
+    EXPECT_EQ(unique.view.column, 3u);
+    EXPECT_EQ(unique.count, 3u);
+    EXPECT_EQ(unique.firstLine, 1u);
+    EXPECT_EQ(unique.lastLine, 105u);
+    EXPECT_EQ(first.Lines()[1].count, 1u);
+}
+
+TEST(Baseline, Fingerprints_without_build_directory)
+{
+    CompilerOutputFingerprintSet fingerprints;
+    fingerprints.AddPathPrefix("/build/1/");
+    fingerprints.AddPathPrefix("/build/2");
+    fingerprints.AddPathPrefix("");
+    EXPECT_TRUE(fingerprints.Insert(fingerprints.Fingerprint(GetCompilerOutputLineView("/build/1/src/a.c:10:3: warning: unused variable 'x'"))));
+    EXPECT_TRUE(fingerprints.Contains(fingerprints.Fingerprint(GetCompilerOutputLineView("/build/2/src/a.c:10:3: warning: unused  variable 'x'"))));
+    EXPECT_TRUE(fingerprints.Contains(fingerprints.Fingerprint(GetCompilerOutputLineView("./src/a.c:10:3: warning: unused variable 'x'"))));
+    EXPECT_FALSE(fingerprints.Contains(fingerprints.Fingerprint(GetCompilerOutputLineView("/build/2/src/a.c:11:3: warning: unused variable 'x'"))));
+    EXPECT_FALSE(fingerprints.Contains(fingerprints.Fingerprint(GetCompilerOutputLineView("/build/20/src/a.c:10:3: warning: unused variable 'x'"))));
+    EXPECT_FALSE(fingerprints.Insert(fingerprints.Fingerprint(GetCompilerOutputLineView("src/a.c:10:3: warning: unused variable 'x'"))));
+    EXPECT_EQ(fingerprints.Size(), 1u);
+}
+
+TEST(Summary, Counts_merged_across_threads)
+{
+    CompilerOutputSummary first;
+    first.Add(GetCompilerOutputLineView("src/a.cpp:3:5: warning: unused variable 'x' [-Wunused-variable]"));
+    first.Add(GetCompilerOutputLineView("src/a.cpp:3:5: note: declared here"));
+    first.Add(GetCompilerOutputLineView("collect2: error: ld returned 1 exit status"));
+    CompilerOutputSummary second;
+    second.Add(GetCompilerOutputLineView("src/b.cpp:8:1: warning: unused variable 'y' [-Wunused-variable]"));
+    second.Add(GetCompilerOutputLineView("src/a.cpp:9:2: warning: comparison of integer expressions of different signedness"));
+    first.Merge(second);
+    EXPECT_EQ(first.Count(CompilerOutputLineType::warning), 3u);
+    EXPECT_EQ(first.Count(CompilerOutputLineType::error), 1u);
+    EXPECT_EQ(first.Count(CompilerOutputRule::preprocessorWarning), 3u);
+    EXPECT_EQ(first.FileCount(), 2u);
+    const auto files = first.TopFiles(1);
+    ASSERT_EQ(files.size(), 1u);
+    EXPECT_EQ(files[0].first, "src/a.cpp");
+    EXPECT_EQ(files[0].second.warnings, 2u);
+    EXPECT_EQ(files[0].second.infos, 1u);
+    const auto warnings = first.TopWarnings(5);
+    ASSERT_EQ(warnings.size(), 2u);
+    EXPECT_EQ(warnings[0].first, "[-Wunused-variable]");
+    EXPECT_EQ(warnings[0].second, 2u);
+}
+
+// What writer writes for views, between Begin() and End()
+template <typename Setup>
+std::string WriteDiagnostics(OutputFormat format, const std::vector<CompilerOutputLineView>& views, Setup&& setup)
+{
+    char* data = nullptr;
+    size_t size = 0;
+    FILE* file = open_memstream(&data, &size);
+    {
+        DiagnosticWriter writer(format, file);
+        setup(writer);
+        writer.Begin();
+        for (const CompilerOutputLineView& view : views) writer.Write(view);
+        writer.End();
+    }
+    fclose(file);
+    std::string written(data, size);
+    free(data);
+    return written;
+}
+
+std::string WriteDiagnostics(OutputFormat format, const std::vector<CompilerOutputLineView>& views)
+{
+    return WriteDiagnostics(format, views, [](DiagnosticWriter&) {});
+}
+
+TEST(Writer, Json_escapes)
+{
+    static constexpr char message[] = "tab\there\r\nbell\x07 nul\0 del\x7f \xe2\x80\x98x\xe2\x80\x99";
+    const CompilerOutputLineView view{.type = CompilerOutputLineType::warning,
+                                      .rule = CompilerOutputRule::generalWarning,
+                                      .fileName = "dir/\"quoted\"\\na\xc3\xafve.c",
+                                      .message = std::string_view(message, sizeof(message) - 1)};
+    EXPECT_EQ(WriteDiagnostics(OutputFormat::jsonLines, {view}),
+              "{\"type\":\"warning\",\"rule\":\"General warning\",\"file\":\"dir/\\\"quoted\\\"\\\\na\xc3\xafve.c\","
+              "\"message\":\"tab\\there\\r\\nbell\\u0007 nul\\u0000 del\\u007f \xe2\x80\x98x\xe2\x80\x99\"}\n");
+}
+
+TEST(Writer, Sarif_uris_and_rule_indexes)
+{
+    const std::vector<CompilerOutputLineView> views = {
+        {.type = CompilerOutputLineType::error, .rule = CompilerOutputRule::fatalError, .line = 3, .fileName = "/src/my dir/na\xc3\xafve#1.c",
+         .message = "x"},
+        {.type = CompilerOutputLineType::warning, .rule = CompilerOutputRule::linkerWarningDifferentSizedSections, .fileName = {}, .message = "y"},
+        {.type = CompilerOutputLineType::error, .fileName = "C:\\src\\{a}.c", .message = ""}};
+    const std::string sarif = WriteDiagnostics(OutputFormat::sarif, views);
+    // The rules are listed from fatalError on, ruleIndex is the rule less one
+    EXPECT_NE(sarif.find("\"rules\":[{\"id\":\"Fatal error\"},"), std::string::npos);
+    EXPECT_NE(sarif.find("{\"ruleId\":\"Fatal error\",\"ruleIndex\":0,\"level\":\"error\""), std::string::npos);
+    const std::string lastIndex = std::to_string(compilerOutputRuleCount - 2);
+    EXPECT_NE(sarif.find("\"ruleIndex\":" + lastIndex + ",\"level\":\"warning\""), std::string::npos);
+    EXPECT_NE(sarif.find("{\"ruleId\":\"None\",\"level\":\"error\",\"message\":{\"text\":\"None\"}"), std::string::npos);
+    EXPECT_NE(sarif.find("\"uri\":\"file:///src/my%20dir/na%C3%AFve%231.c\"},\"region\":{\"startLine\":3}"), std::string::npos);
+    EXPECT_NE(sarif.find("\"uri\":\"C:%5Csrc%5C%7Ba%7D.c\"}"), std::string::npos);
+
+    // Rules loaded at run time replace the built-in ones
+    CompilerOutputLineView runtime{.type = CompilerOutputLineType::error, .runtimeRule = 1, .fileName = {}, .message = "z"};
+    const std::string runtimeSarif =
+        WriteDiagnostics(OutputFormat::sarif, {runtime}, [](DiagnosticWriter& writer) { writer.SetRuntimeRuleNames({"First", "Second \"B\""}); });
+    EXPECT_NE(runtimeSarif.find("\"rules\":[{\"id\":\"First\"},{\"id\":\"Second \\\"B\\\"\"}]"), std::string::npos);
+    EXPECT_NE(runtimeSarif.find("{\"ruleId\":\"Second \\\"B\\\"\",\"ruleIndex\":1,"), std::string::npos);
+}
+
+// Indexes the diagnostics of lines and appends the lines to parsed
+uint64_t IndexTestLines(std::string_view lines, uint64_t firstLogLine, LogIndexSegment& segment, std::string& parsed)
+{
+    parsed += lines;
+    uint64_t lineIndex = 0;
+    ForEachCompilerOutputLine(lines,
+                              [&](std::string_view line)
+                              {
+                                  const CompilerOutputLineView view = GetCompilerOutputLineView(line);
+                                  if (view.type != CompilerOutputLineType::normal) segment.Add(view, firstLogLine + lineIndex);
+                                  ++lineIndex;
+                              });
+    return lineIndex;
+}
+
+TEST(LogIndex, Appended_lines_parsed_once)
+{
+    const std::string indexPath = testing::TempDir() + "appended_lines.idx";
+    unlink(indexPath.c_str());
+    std::string parsed;
+    auto parse = [&parsed](std::string_view lines, uint64_t firstLogLine, LogIndexSegment& segment)
+    { return IndexTestLines(lines, firstLogLine, segment, parsed); };
+    std::string log = "src/a.c:1:1: error: one\nmake: Nothing to be done\n";
+    LogIndex index;
+    ASSERT_TRUE(UpdateLogIndex(indexPath.c_str(), log, 0, index, parse));
+    EXPECT_EQ(index.RecordCount(), 1u);
+
+    // Only the new whole lines, the unterminated one waits for its end
+    log += "src/b.c:2:1: warning: two\nsrc/a.c:3:1: error: thr";
+    parsed.clear();
+    ASSERT_TRUE(UpdateLogIndex(indexPath.c_str(), log, 0, index, parse));
+    EXPECT_EQ(parsed, "src/b.c:2:1: warning: two\n");
+    EXPECT_EQ(index.Header().segmentCount, 2u);
+    EXPECT_EQ(index.Header().lineCount, 3u);
+    std::vector<std::pair<uint64_t, std::string_view>> records;
+    index.ForEach([&](const LogIndexRecord& record, const CompilerOutputLineView& view) { records.emplace_back(record.logLine, view.fileName); });
+    EXPECT_EQ(records, (std::vector<std::pair<uint64_t, std::string_view>>{{1, "src/a.c"}, {3, "src/b.c"}}));
+    EXPECT_EQ(index.FileNames().size(), 2u);
+
+    log += "ee\n";
+    parsed.clear();
+    ASSERT_TRUE(UpdateLogIndex(indexPath.c_str(), log, 0, index, parse));
+    EXPECT_EQ(parsed, "src/a.c:3:1: error: three\n");
+    // The file name keeps the id of its first segment
+    EXPECT_EQ(index.FileNames().size(), 2u);
+    parsed.clear();
+    ASSERT_TRUE(UpdateLogIndex(indexPath.c_str(), log, 0, index, parse));
+    EXPECT_EQ(parsed, "");
+
+    // Other rules, then a replaced log, are indexed again from the start
+    parsed.clear();
+    ASSERT_TRUE(UpdateLogIndex(indexPath.c_str(), log, 42, index, parse));
+    EXPECT_EQ(parsed, log);
+    EXPECT_EQ(index.Header().segmentCount, 1u);
+    log[0] = 'S';
+    parsed.clear();
+    ASSERT_TRUE(UpdateLogIndex(indexPath.c_str(), log, 42, index, parse));
+    EXPECT_EQ(parsed, log);
+    EXPECT_EQ(index.RecordCount(), 3u);
+    unlink(indexPath.c_str());
+}
+
+TEST(LogIndex, Damaged_records_rejected)
+{
+    const std::string indexPath = testing::TempDir() + "damaged_records.idx";
+    unlink(indexPath.c_str());
+    std::string parsed;
+    {
+        LogIndex index;
+        ASSERT_TRUE(UpdateLogIndex(indexPath.c_str(), "src/a.c:1:1: error: one\n", 0, index,
+                                   [&parsed](std::string_view lines, uint64_t firstLogLine, LogIndexSegment& segment)
+                                   { return IndexTestLines(lines, firstLogLine, segment, parsed); }));
+    }
+    std::ifstream input(indexPath, std::ios::binary);
+    const std::string good((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    input.close();
+    const size_t record = sizeof(LogIndexHeader) + sizeof(LogIndexSegmentHeader);
+    auto opens = [&indexPath, &good](size_t offset, const void* value, size_t size)
+    {
+        std::string damaged = good;
+        damaged.replace(offset, size, static_cast<const char*>(value), size);
+        std::ofstream(indexPath, std::ios::binary | std::ios::trunc) << damaged;
+        LogIndex index;
+        return index.Open(indexPath.c_str());
+    };
+    const uint8_t zero = 0;
+    EXPECT_TRUE(opens(0, good.data(), 1));
+    EXPECT_FALSE(opens(0, "X", 1));
+    const uint8_t rule = compilerOutputRuleCount;
+    EXPECT_FALSE(opens(record + offsetof(LogIndexRecord, rule), &rule, sizeof(rule)));
+    EXPECT_TRUE(opens(record + offsetof(LogIndexRecord, rule), &zero, sizeof(zero)));
+    const CompilerOutputLineType type = static_cast<CompilerOutputLineType>(4);
+    EXPECT_FALSE(opens(record + offsetof(LogIndexRecord, type), &type, sizeof(type)));
+    const uint64_t message = good.size();
+    EXPECT_FALSE(opens(record + offsetof(LogIndexRecord, message), &message, sizeof(message)));
+    const uint32_t fileName = 1;
+    EXPECT_FALSE(opens(record + offsetof(LogIndexRecord, fileName), &fileName, sizeof(fileName)));
+    // A torn update, the header covers more than the file
+    const uint64_t size = good.size() + 8;
+    EXPECT_FALSE(opens(offsetof(LogIndexHeader, size), &size, sizeof(size)));
+    unlink(indexPath.c_str());
+}
+
+// Lines of different lengths, one longer than the blocks of ReadCompressedTestLog
+std::string CompressedTestLines()
+{
+    std::string lines;
+    for (int i = 0; i < 200; ++i)
+    {
+        lines += "src/file" + std::to_string(i) + ".c:" + std::to_string(i) + ":1: warning: unused" + std::string(i % 7, 'x') + "\n";
+    }
+    lines += std::string(300, 'y') + "\n";
+    return lines + "last line without newline";
+}
+
+// The blocks of a small block size put back together
+std::string ReadCompressedTestLog(std::string_view data, LogCompression compression, int& error)
+{
+    CompressedLogStream stream(data, compression, 64);
+    std::string log;
+    std::string_view block;
+    while (stream.ReadBlock(block))
+    {
+        // Only the last block ends in a partial line
+        EXPECT_TRUE(log.empty() || log.ends_with('\n'));
+        log += block;
+    }
+    error = stream.Error();
+    return log;
+}
+
+#ifdef LOG_PARSER_WITH_ZLIB
+std::string GzipTestMember(std::string_view data)
+{
+    z_stream stream{};
+    EXPECT_EQ(deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY), Z_OK);
+    std::string member(deflateBound(&stream, static_cast<uLong>(data.size())), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = reinterpret_cast<Bytef*>(member.data());
+    stream.avail_out = static_cast<uInt>(member.size());
+    EXPECT_EQ(deflate(&stream, Z_FINISH), Z_STREAM_END);
+    member.resize(stream.total_out);
+    deflateEnd(&stream);
+    return member;
+}
+
+TEST(CompressedLog, Gzip_members)
+{
+    const std::string lines = CompressedTestLines();
+    const std::string firstLines = lines.substr(0, lines.size() / 2);
+    // As written by gzip -c a >> log; gzip -c b >> log
+    const std::string log = GzipTestMember(firstLines) + GzipTestMember(lines.substr(firstLines.size()));
+    ASSERT_EQ(DetectLogCompression(log), LogCompression::gzip);
+    int error = -1;
+    EXPECT_EQ(ReadCompressedTestLog(log, LogCompression::gzip, error), lines);
+    EXPECT_EQ(error, 0);
+
+    const std::string truncated = log.substr(0, log.size() - 12);
+    const std::string read = ReadCompressedTestLog(truncated, LogCompression::gzip, error);
+    EXPECT_TRUE(lines.starts_with(read));
+    EXPECT_EQ(error, EBADMSG);
+    EXPECT_EQ(ReadCompressedTestLog("\x1f\x8b garbage", LogCompression::gzip, error), "");
+    EXPECT_EQ(error, EBADMSG);
+}
+#endif
+
+#ifdef LOG_PARSER_WITH_ZSTD
+TEST(CompressedLog, Zstd_frames)
+{
+    const std::string lines = CompressedTestLines();
+    std::string log;
+    for (const std::string_view part : {std::string_view(lines).substr(0, 1000), std::string_view(lines).substr(1000)})
+    {
+        std::string frame(ZSTD_compressBound(part.size()), '\0');
+        const size_t size = ZSTD_compress(frame.data(), frame.size(), part.data(), part.size(), 3);
+        ASSERT_FALSE(ZSTD_isError(size));
+        log.append(frame.data(), size);
+    }
+    ASSERT_EQ(DetectLogCompression(log), LogCompression::zstd);
+    int error = -1;
+    EXPECT_EQ(ReadCompressedTestLog(log, LogCompression::zstd, error), lines);
+    EXPECT_EQ(error, 0);
+
+    const std::string read = ReadCompressedTestLog(std::string_view(log).substr(0, log.size() - 5), LogCompression::zstd, error);
+    EXPECT_TRUE(lines.starts_with(read));
+    EXPECT_EQ(error, EBADMSG);
+}
+#endif
+
+TEST(CompressedLog, Unsupported_compression)
+{
+    int error = 0;
+    EXPECT_EQ(ReadCompressedTestLog("abc\n", LogCompression::none, error), "");
+    EXPECT_EQ(error, ENOTSUP);
+}
+
+TEST(BuildCommand, Passthrough_backlog_dropped_and_counted)
+{
+    // Only read once the command has handed out all of its lines, the backlog overflows while the pipe is full
+    int passthrough[2];
+    ASSERT_EQ(pipe2(passthrough, O_CLOEXEC), 0);
+    const char* argv[] = {"sh", "-c", "yes abcdefghi | head -n 40000", nullptr};
+    std::string received;
+    std::thread reader;
+    {
+        BuildCommand command(16 << 10);
+        ASSERT_TRUE(command.Start(const_cast<char* const*>(argv), passthrough[1]));
+        size_t lines = 0;
+        while (command.ReadLines([&](std::string_view line) { lines += line == "abcdefghi"; }))
+        {
+            if (lines == 40000 && !reader.joinable())
+            {
+                reader = std::thread(
+                    [&]
+                    {
+                        char buffer[4096];
+                        ssize_t count;
+                        while ((count = read(passthrough[0], buffer, sizeof(buffer))) > 0) received.append(buffer, static_cast<size_t>(count));
+                    });
+            }
+        }
+        EXPECT_EQ(lines, 40000u);
+        EXPECT_EQ(command.Error(), 0);
+        EXPECT_EQ(command.Wait(), 0);
+    }
+    close(passthrough[1]);
+    if (reader.joinable()) reader.join();
+    close(passthrough[0]);
+
+    const std::string_view notePrefix = "log-parser: ";
+    const size_t note = received.rfind(notePrefix);
+    ASSERT_NE(note, std::string::npos);
+    const uint64_t dropped = std::stoull(received.substr(note + notePrefix.size()));
+    EXPECT_GT(dropped, 0u);
+    EXPECT_TRUE(received.ends_with(" bytes of output were not passed through\n"));
+    // What was passed through is the start of the output, the rest was dropped
+    std::string output;
+    for (size_t i = 0; i < 40000; ++i) output += "abcdefghi\n";
+    EXPECT_EQ(note + dropped, output.size());
+    EXPECT_EQ(received.substr(0, note), output.substr(0, note));
+}
+
+TEST(Group, Context_notes_and_quoted_lines)
+{
+    const std::string log =
+        "[1/3] Building CXX object a.o\n"
+        "In file included from /src/a.h:3,\n"
+        "                 from /src/a.cpp:1:\n"
+        "/src/b.h: In function 'void f()':\n"
+        "/src/b.h:10:3: error: 'x' was not declared in this scope\n"
+        "   10 |   x = 1;\n"
+        "      |   ^\n"
+        "/src/b.h:5:2: note: declared here\n"
+        "/src/c.h: In instantiation of 'void g() [with T = int]':\n"
+        "/src/a.cpp:20:5:   required from here\n"
+        "/src/c.h:12:7: error: no match\n"
+        "[2/3] Linking CXX executable a\n";
+    CompilerOutputGrouper grouper;
+    std::vector<CompilerOutputDiagnosticGroup> groups;
+    CompilerOutputDiagnosticGroup group;
+    ForEachCompilerOutputLine(log,
+                              [&](std::string_view line)
+                              {
+                                  if (grouper.Add(line, GetCompilerOutputLineView(line), group)) groups.push_back(std::move(group));
+                              });
+    EXPECT_FALSE(grouper.Finish(group));
+    ASSERT_EQ(groups.size(), 2u);
+    EXPECT_EQ(groups[0].includedFrom.size(), 2u);
+    ASSERT_EQ(groups[0].context.size(), 1u);
+    EXPECT_EQ(groups[0].context[0].rule, CompilerOutputRule::inFunctionInfo);
+    EXPECT_EQ(groups[0].primary.line, 10u);
+    EXPECT_EQ(groups[0].primary.quotedLines.size(), 2u);
+    ASSERT_EQ(groups[0].notes.size(), 1u);
+    EXPECT_EQ(groups[0].notes[0].message, "note: declared here");
+    EXPECT_EQ(groups[1].context.size(), 2u);
+    EXPECT_EQ(groups[1].primary.message, "error: no match");
+    EXPECT_TRUE(groups[1].notes.empty());
+}
+
+TEST(Escapes, Colored_diagnostic)
+{
+    const std::string_view plain = "/src/a.cpp:3:5: error: 'x' was not declared in this scope";
+    std::string scratch;
+    EXPECT_EQ(StripCompilerOutputEscapes(plain, scratch).data(), plain.data());
+
+    const std::string colored =
+        "\x1b[01m\x1b[K/src/a.cpp:3:5:\x1b[m\x1b[K \x1b[01;31m\x1b[Kerror: \x1b[m\x1b[K'\x1b[01m\x1b[Kx\x1b[m\x1b[K' was not declared in this scope"
+        " [\x1b]8;;https://gcc.gnu.org/onlinedocs/gcc/Warning-Options.html\x1b\\-Wfoo\x1b]8;;\x1b\\]";
+    const std::string_view stripped = StripCompilerOutputEscapes(colored, scratch);
+    EXPECT_EQ(stripped, "/src/a.cpp:3:5: error: 'x' was not declared in this scope [-Wfoo]");
+    const CompilerOutputLineView view = GetCompilerOutputLineView(stripped);
+    EXPECT_EQ(view.type, CompilerOutputLineType::error);
+    EXPECT_EQ(view.fileName, "/src/a.cpp");
+    EXPECT_EQ(view.line, 3u);
+
+    // In place over several lines, newlines stay and a sequence cut short at the end goes
+    std::string lines = "\x1b[01;35m\x1b[Kwarning: \x1b[m\x1b[Kw\nplain\n\x1b[1";
+    lines.resize(StripCompilerOutputEscapes(lines.data(), lines.size()));
+    EXPECT_EQ(lines, "warning: w\nplain\n");
+}
+
+TEST(RuntimeRules, First_matching_rule_wins)
+{
+    const std::string_view xml = R"(<CodeBlocks_compiler_options>
+    <RegEx name="Clang error" type="error" msg="4" file="1" line="2" column="3">
+        <![CDATA[^([^:]+):([0-9]+):([0-9]+): (error: .*)$]]>
+    </RegEx>
+    <!-- <RegEx name="Commented out" type="error" msg="1"><![CDATA[(.*)]]></RegEx> -->
+    <RegEx name="General warning" type="warning" msg="1"><![CDATA[([Ww]arning:[[:blank:]].*)]]></RegEx>
+    <RegEx name="Progress" type="info" msg="1"><![CDATA[^(\[[0-9]+/[0-9]+\] ).*done$]]></RegEx>
+</CodeBlocks_compiler_options>)";
+    CompilerOutputRuntimeParser parser;
+    std::string error;
+    ASSERT_TRUE(parser.LoadCodeBlocksXml(xml, error)) << error;
+    ASSERT_EQ(parser.Rules().size(), 3u);
+    parser.MapRuleNames(GetCompilerOutputRuleName);
+
+    CompilerOutputLineView view = parser.Parse("src/a.c:12:5: error: warning: x");
+    EXPECT_EQ(view.type, CompilerOutputLineType::error);
+    EXPECT_EQ(view.rule, CompilerOutputRule::none);
+    EXPECT_EQ(view.runtimeRule, 0u);
+    EXPECT_EQ(view.fileName, "src/a.c");
+    EXPECT_EQ(view.line, 12u);
+    EXPECT_EQ(view.column, 5u);
+    EXPECT_EQ(view.message, "error: warning: x");
+
+    // Searched for in the line, from the earliest place it matches
+    view = parser.Parse("make: Warning: clock skew, warning: again");
+    EXPECT_EQ(view.type, CompilerOutputLineType::warning);
+    EXPECT_EQ(view.rule, CompilerOutputRule::generalWarning);
+    EXPECT_EQ(view.runtimeRule, 1u);
+    EXPECT_EQ(view.message, "Warning: clock skew, warning: again");
+
+    EXPECT_EQ(parser.Parse("[1/20] done").message, "[1/20] ");
+    EXPECT_EQ(parser.Parse("[1/20] done later").type, CompilerOutputLineType::normal);
+
+    CompilerOutputRuntimeParser broken;
+    EXPECT_FALSE(broken.LoadCodeBlocksXml(R"(<RegEx name="Broken" type="error" msg="1"><![CDATA[(a]]></RegEx>)", error));
+    EXPECT_EQ(error, "rule 'Broken': missing ) at offset 2");
+    EXPECT_FALSE(broken.LoadCodeBlocksXml(R"(<!-- <RegEx name="A" type="error" msg="1"><![CDATA[(a)]]></RegEx>)", error));
+    EXPECT_EQ(error, "unterminated comment");
+}
+
+TEST(RuntimeRules, Pike_captures_of_a_large_program)
+{
+    // About 300000 instructions that consume no byte in a row, too many times the line length for the backtracker
+    CompilerOutputRuntimeParser parser;
+    std::string error;
+    CompilerOutputRuntimeRule rule{.name = "Large", .pattern = "^(((a?){1000}){100}b.*)$", .type = CompilerOutputLineType::error, .messageIdx = 1};
+    ASSERT_TRUE(parser.AddRule(std::move(rule), error)) << error;
+    parser.Compile();
+    EXPECT_EQ(parser.Parse("b").message, "b");
+    EXPECT_EQ(parser.Parse("aab: long enough").message, "aab: long enough");
+    EXPECT_EQ(parser.Parse("aac: long enough").type, CompilerOutputLineType::normal);
+}
+
 int main(int argc, char **argv)
 {
     testing::InitGoogleTest(&argc, argv);